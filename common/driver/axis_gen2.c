@@ -22,10 +22,17 @@
 #include <linux/seq_file.h>
 #include <linux/signal.h>
 #include <linux/slab.h>
+#include <linux/sched.h>
+#include <linux/jiffies.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/io.h>
+#include <linux/prefetch.h>
 
 // Set functions for gen2 card
 struct hardware_functions AxisG2_functions = {
    .irq             = AxisG2_Irq,
+   .irqThread       = AxisG2_IrqThread,
    .init            = AxisG2_Init,
    .enable          = AxisG2_Enable,
    .clear           = AxisG2_Clear,
@@ -36,8 +43,8 @@ struct hardware_functions AxisG2_functions = {
 };
 
 
-// Map return descriptors to return record
-inline uint8_t AxisG2_MapReturn ( struct DmaDevice * dev, struct AxisG2Return *ret, uint32_t desc128En, uint32_t index, uint32_t *ring) {
+// Map return descriptors to return record, entry is cleared by caller
+inline uint8_t AxisG2_MapReturn ( struct AxisG2Return *ret, uint32_t desc128En, uint32_t index, uint32_t *ring) {
    uint32_t * ptr;
    uint32_t chan;
    uint32_t dest;
@@ -68,16 +75,47 @@ inline uint8_t AxisG2_MapReturn ( struct DmaDevice * dev, struct AxisG2Return *r
       ret->cont   = (ptr[0] >>  3) & 0x1;
       ret->result = ptr[0] & 0x7;
    }
+   return 1;
+}
 
-   if ( dev->debug > 0 ) 
-      dev_info(dev->device,"Irq: desc idx %i, raw 0x%x, 0x%x, 0x%x, 0x%x\n",index,ptr[0],ptr[1],ptr[2],ptr[3]);
+// Map a batch of completions up to hardware index, consumed entries are cleared in bulk
+// Entries are cleared before the caller re-posts buffers so hardware can not reuse an uncleared slot.
+// Stops early at an entry which has not landed yet. Returns number of entries mapped.
+uint32_t AxisG2_MapBatch ( struct AxisG2Return *ret, uint32_t desc128En, uint32_t *ring, uint32_t addrCount,
+                           uint32_t *index, uint32_t hwIndex, uint32_t max ) {
+   uint32_t words;
+   uint32_t avail;
+   uint32_t first;
+   uint32_t cnt;
 
-   memset(ptr,0,(desc128En?16:8));
-   return 1;
+   words = (desc128En?4:2);
+   avail = ((hwIndex + addrCount - *index) % addrCount);
+
+   if ( avail > max ) avail = max;
+   if ( avail > AXIS2_BATCH ) avail = AXIS2_BATCH;
+
+   for (cnt=0; cnt < avail; cnt++)
+      if ( ! AxisG2_MapReturn(&(ret[cnt]),desc128En,((*index + cnt) % addrCount),ring) ) break;
+
+   if ( cnt == 0 ) return(0);
+
+   // Clear consumed entries, at most two segments on wrap
+   first = addrCount - *index;
+   if ( first > cnt ) first = cnt;
+
+   memset(ring + (*index * words),0,first * words * 4);
+   if ( cnt > first ) memset(ring,0,(cnt - first) * words * 4);
+
+   *index = ((*index + cnt) % addrCount);
+
+   // Next batch
+   prefetch(ring + (*index * words));
+   return(cnt);
 }
 
 // Add buffer to free list
-inline void AxisG2_WriteFree ( struct DmaBuffer *buff, struct AxisG2Reg *reg, uint32_t desc128En ) {
+inline void AxisG2_WriteFree ( struct DmaBuffer *buff, struct AxisG2Engine *eng, uint32_t desc128En ) {
+   struct AxisG2Reg *reg = eng->reg;
    uint32_t wrData[2];
 
    wrData[0] = buff->index & 0x0FFFFFFF;
@@ -88,13 +126,19 @@ inline void AxisG2_WriteFree ( struct DmaBuffer *buff, struct AxisG2Reg *reg, ui
 
       iowrite32(wrData[1],&(reg->writeFifoB));
    }
-   else iowrite32(buff->buffHandle,&(reg->dmaAddr[buff->index])); // Address table
+   else {
+      iowrite32(buff->buffHandle,&(eng->addrTable[buff->index])); // Address table
+
+      // Table entry must land before descriptor
+      if ( eng->addrTableWc ) wmb();
+   }
 
    iowrite32(wrData[0],&(reg->writeFifoA));
 }
 
 // Add buffer to tx list
-inline void AxisG2_WriteTx ( struct DmaBuffer *buff, struct AxisG2Reg *reg, uint32_t desc128En ) {
+inline void AxisG2_WriteTx ( struct DmaBuffer *buff, struct AxisG2Engine *eng, uint32_t desc128En ) {
+   struct AxisG2Reg *reg = eng->reg;
    uint32_t rdData[4];
    uint32_t dest;
    uint32_t chan;
@@ -116,8 +160,14 @@ inline void AxisG2_WriteTx ( struct DmaBuffer *buff, struct AxisG2Reg *reg, uint
       rdData[2] |= (buff->buffHandle << 24) & 0xF0000000; // Addr bits 7:4 
       rdData[3]  = (buff->buffHandle >>  8) & 0xFFFFFFFF; // Addr bits 39:8
 
-      iowrite32(rdData[3],&(reg->readFifoD));
-      iowrite32(rdData[2],&(reg->readFifoC));
+#ifdef writeq
+      if ( eng->postWide ) writeq(((uint64_t)rdData[3] << 32) | rdData[2],&(reg->readFifoC));
+      else
+#endif
+      {
+         iowrite32(rdData[3],&(reg->readFifoD));
+         iowrite32(rdData[2],&(reg->readFifoC));
+      }
    }
    else {
 
@@ -126,164 +176,561 @@ inline void AxisG2_WriteTx ( struct DmaBuffer *buff, struct AxisG2Reg *reg, uint
       rdData[1]  = buff->size & 0x00FFFFFF;   // bits[23:0]  = size
       rdData[1] |= (buff->dest << 24) & 0xFF000000; // bits[31:24] = dest
 
-      iowrite32(buff->buffHandle,&(reg->dmaAddr[buff->index])); // Address table
+      iowrite32(buff->buffHandle,&(eng->addrTable[buff->index])); // Address table
+
+      // Table entry must land before descriptor
+      if ( eng->addrTableWc ) wmb();
+   }
+
+#ifdef writeq
+   if ( eng->postWide ) {
+      writeq(((uint64_t)rdData[1] << 32) | rdData[0],&(reg->readFifoA));
+      return;
    }
+#endif
 
    iowrite32(rdData[1],&(reg->readFifoB));
    iowrite32(rdData[0],&(reg->readFifoA));
 }
 
 
-// Interrupt handler
-irqreturn_t AxisG2_Irq(int irq, void *dev_id) {
-   uint32_t handleCount;
+// Post receive buffers to engine free list, remainder is queued when ring is full
+// Returns number of buffers queued for the interrupt path
+uint32_t AxisG2_PostFree(struct AxisG2Data *hwData, struct AxisG2Engine *eng, struct DmaBuffer **buff, uint32_t count) {
+   unsigned long iflags;
+   uint32_t x;
 
-   struct DmaDesc     * desc;
-   struct DmaBuffer   * buff;
-   struct DmaBuffer  ** buffList;
-   struct DmaDevice   * dev;
-   struct AxisG2Reg   * reg;
-   struct AxisG2Data  * hwData;
-   struct AxisG2Return ret;
+   dmaSpinLockIrqSave(&eng->wrLock,&eng->wrStats,iflags);
 
+   for (x=0; (x < count) && (eng->hwWrBuffCnt < (eng->addrCount-1)); x++) {
+      AxisG2_WriteFree(buff[x],eng,hwData->desc128En);
+      ++eng->hwWrBuffCnt;
+   }
+   if ( x < count ) dmaQueuePushListIrq(&(eng->wrQueue),&(buff[x]),count-x);
+
+   spin_unlock_irqrestore(&eng->wrLock,iflags);
+   return(count-x);
+}
+
+// Queue transmit buffer on its dest class, called with read ring lock held
+void AxisG2_TxQueue(struct AxisG2Data *hwData, struct AxisG2Engine *eng, struct DmaBuffer *buff) {
+   struct AxisG2TxClass * cls;
+   uint32_t depth;
+
+   cls = &(eng->txq[((hwData->txClass != NULL) && (buff->dest < DMA_MAX_DEST)) ? hwData->txClass[buff->dest] : 0]);
+   buff->qTime = ktime_get_ns();
+
+   if ( dmaQueuePushIrq(&(cls->q),buff) == 0 ) {
+      ++eng->txQueued;
+      depth = dmaQueueCount(&(cls->q));
+      if ( depth > cls->maxDepth ) cls->maxDepth = depth;
+   }
+}
+
+// Feed read ring from transmit class queues, called with read ring lock held
+// Strict classes drain first in class order, others are served round robin with weight frames per turn
+void AxisG2_TxFeed(struct AxisG2Data *hwData, struct AxisG2Engine *eng) {
+   struct AxisG2TxClass * cls;
+   struct DmaBuffer     * buff;
+   uint64_t wait;
+   uint32_t c;
+   uint32_t n;
+
+   while ( (eng->txQueued > 0) && (eng->hwRdBuffCnt < (eng->addrCount-1)) ) {
+      buff = NULL;
+
+      // Strict classes
+      for (c=0; (buff == NULL) && (c < AXIS_TX_CLASSES); c++)
+         if ( hwData->txStrict[c] && ((buff = dmaQueuePopIrq(&(eng->txq[c].q))) != NULL) ) break;
+
+      // Weighted classes, move to next class when credit is used or class is empty
+      for (n=0; (buff == NULL) && (n < (2*AXIS_TX_CLASSES)); n++) {
+         c = eng->txRr;
+         if ( (!hwData->txStrict[c]) && (eng->txCredit > 0) && ((buff = dmaQueuePopIrq(&(eng->txq[c].q))) != NULL) )
+            eng->txCredit--;
+         else {
+            eng->txRr = (c + 1) % AXIS_TX_CLASSES;
+            eng->txCredit = hwData->txWeight[eng->txRr];
+         }
+      }
+
+      // Count is out of sync with queues, should not occur
+      if ( buff == NULL ) {
+         eng->txQueued = 0;
+         break;
+      }
+      --eng->txQueued;
+
+      cls  = &(eng->txq[c]);
+      wait = ktime_get_ns() - buff->qTime;
+      cls->frames++;
+      cls->waitNs += wait;
+      if ( wait > cls->maxWaitNs ) cls->maxWaitNs = wait;
+
+      AxisG2_WriteTx(buff,eng,1);
+      ++eng->hwRdBuffCnt;
+   }
+}
+
+// Post transmit buffers to engine, remainder is queued on dest class when ring is full
+// Sends are only posted directly while nothing is queued, to keep frame order
+// Returns number of buffers queued for the interrupt path
+uint32_t AxisG2_PostTx(struct AxisG2Data *hwData, struct AxisG2Engine *eng, struct DmaBuffer **buff, uint32_t count) {
+   unsigned long iflags;
+   uint32_t queued;
    uint32_t x;
-   uint32_t bCnt;
-   uint32_t rCnt;
 
-   dev    = (struct DmaDevice *)dev_id;
-   reg    = (struct AxisG2Reg *)dev->reg;
-   hwData = (struct AxisG2Data *)dev->hwData;
+   dmaSpinLockIrqSave(&eng->rdLock,&eng->rdStats,iflags);
 
-   // Disable interrupt
-   iowrite32(0x0,&(reg->intEnable));
-   handleCount = 0;
+   queued = 0;
+   for (x=0; x < count; x++) {
+      if ( (eng->txQueued == 0) && (eng->hwRdBuffCnt < (eng->addrCount-1)) ) {
+         AxisG2_WriteTx(buff[x],eng,hwData->desc128En);
+         ++eng->hwRdBuffCnt;
+      }
+      else {
+         AxisG2_TxQueue(hwData,eng,buff[x]);
+         ++queued;
+      }
+   }
 
-   if ( dev->debug > 0 ) dev_info(dev->device,"Irq: Called.\n");
+   spin_unlock_irqrestore(&eng->rdLock,iflags);
+   return(queued);
+}
 
-   ////////////////// Transmit Buffers /////////////////////////
+// Reclaim transmit completions up to hardware index and refill the transmit ring
+// Called with ring lock held and local interrupts disabled, returns completions handled
+static __always_inline uint32_t AxisG2_TxRingT(struct DmaDevice *dev, struct AxisG2Data *hwData, struct AxisG2Engine *eng,
+                                               uint32_t budget, uint32_t hwIndex, const uint32_t desc128En, const uint32_t debug) {
+   struct DmaBuffer    * buff;
+   struct AxisG2Return ret[AXIS2_BATCH];
 
-   // Check read (transmit) returns
-   while ( AxisG2_MapReturn(dev,&ret,hwData->desc128En,hwData->readIndex,hwData->readAddr) ) {
-      ++handleCount;
-      --(hwData->hwRdBuffCnt);
+   uint32_t txCount;
+   uint32_t bCnt;
+   uint32_t x;
 
-      if ( dev->debug > 0 ) dev_info(dev->device,"Irq: Got TX Descriptor: Idx=%i, Pos=%i\n",ret.index,hwData->readIndex);
-      // Attempt to find buffer in tx pool and return. otherwise return rx entry to hw.
-      // Must adjust counters here and check for buffer need
-      if ((buff = dmaRetBufferIdxIrq (dev,ret.index)) != NULL) {
+   txCount = 0;
 
-         // Add to receive/write software queue
-         if ( hwData->hwWrBuffCnt >= (hwData->addrCount-1) ) dmaQueuePushIrq(&(hwData->wrQueue),buff);
+   while ( (txCount < budget) &&
+           ((bCnt = AxisG2_MapBatch(ret,desc128En,eng->readAddr,eng->addrCount,&(eng->readIndex),hwIndex,budget-txCount)) > 0) ) {
+      txCount += bCnt;
+      eng->hwRdBuffCnt -= bCnt;
 
-         // Add to receive/write hardware queue
-         else {
-            ++(hwData->hwWrBuffCnt);
-            AxisG2_WriteFree(buff,reg,hwData->desc128En);
+      for (x=0; x < bCnt; x++) {
+         if ( debug > 0 ) Dma_Trace(dev,DMA_TRACE_TX,ret[x].index,0,0,0,0);
+
+         // Attempt to find buffer in tx pool and return. otherwise return rx entry to hw.
+         // Must adjust counters here and check for buffer need
+         if ((buff = dmaRetBufferIdxIrq (dev,ret[x].index)) != NULL) {
+            dmaSpinLock(&eng->wrLock,&eng->wrStats);
+
+            // Add to receive/write software queue
+            if ( eng->hwWrBuffCnt >= (eng->addrCount-1) ) dmaQueuePushIrq(&(eng->wrQueue),buff);
+
+            // Add to receive/write hardware queue
+            else {
+               ++(eng->hwWrBuffCnt);
+               AxisG2_WriteFree(buff,eng,desc128En);
+            }
+            spin_unlock(&eng->wrLock);
          }
       }
-      hwData->readIndex = ((hwData->readIndex+1) % hwData->addrCount);
-      if ( handleCount > 1000 ) break;
    }
 
-   // Process transmit software queue
-   if ( hwData->desc128En ) {
-      while ( (hwData->hwRdBuffCnt < (hwData->addrCount-1)) && ((buff = dmaQueuePopIrq(&(hwData->rdQueue))) != NULL) ) {
+   // Feed transmit class queues
+   if ( desc128En ) AxisG2_TxFeed(hwData,eng);
 
-         // Write to hardware
-         AxisG2_WriteTx(buff,reg,hwData->desc128En);
-         ++hwData->hwRdBuffCnt;
-      }
+   return(txCount);
+}
+
+// Process TX and RX rings of a single engine, each ring is limited to budget entries
+// Hardware ring indexes give the number of completions, which are handled in batches
+// Constant desc128En and debug are folded in each specialized instance below
+// Called with local interrupts disabled
+static __always_inline uint32_t AxisG2_ProcessEngineT(struct DmaDevice *dev, struct AxisG2Data *hwData, struct AxisG2Engine *eng,
+                                                      uint32_t budget, const uint32_t desc128En, const uint32_t debug) {
+   uint32_t handleCount;
+   uint32_t txCount;
+   uint32_t rxCount;
+   uint32_t refill;
+
+   struct DmaBuffer    * buff;
+   struct DmaBuffer   ** buffList;
+   struct AxisG2Return ret[AXIS2_BATCH];
+
+   uint32_t hwIndex;
+   uint32_t x;
+   uint32_t bCnt;
+   uint32_t rCnt;
+
+   handleCount = 0;
+   txCount = 0;
+   rxCount = 0;
+   refill  = 0;
+
+   ////////////////// Transmit Buffers /////////////////////////
+
+   dmaSpinLock(&eng->rdLock,&eng->rdStats);
+
+   // Check read (transmit) returns
+   hwIndex = ioread32(&(eng->reg->hwRdIndex));
+
+   if ( dev->cfgTxLazy == 0 ) {
+      txCount = AxisG2_TxRingT(dev,hwData,eng,budget,hwIndex,desc128En,debug);
+      handleCount += txCount;
+   }
+
+   // Lazy reclaim, completions are acked by index now and reaped from process context,
+   // unless the transmit buffer queue is below the low water mark or sends are queued
+   else {
+      handleCount += ((hwIndex + eng->addrCount - eng->txAckIndex) % eng->addrCount);
+      eng->txAckIndex = hwIndex;
+
+      if ( (dmaQueueCount(&(dev->tq)) < dev->cfgTxLazy) || (desc128En && (eng->txQueued > 0)) )
+         txCount = AxisG2_TxRingT(dev,hwData,eng,budget,hwIndex,desc128En,debug);
    }
 
+   spin_unlock(&eng->rdLock);
+
    ////////////////// Receive Buffers /////////////////////////
 
-   // Lock mask
-   spin_lock(&dev->maskLock);
+   // Lock mask, then ring
+   dmaSpinLock(&dev->maskLock,&dev->maskStats);
+   dmaSpinLock(&eng->wrLock,&eng->wrStats);
 
    // Check write descriptor
-   while ( AxisG2_MapReturn(dev,&ret,hwData->desc128En,hwData->writeIndex,hwData->writeAddr) ) {
-      ++handleCount;
-      --(hwData->hwWrBuffCnt);
+   hwIndex = ioread32(&(eng->reg->hwWrIndex));
+
+   while ( (rxCount < budget) &&
+           ((bCnt = AxisG2_MapBatch(ret,desc128En,eng->writeAddr,eng->addrCount,&(eng->writeIndex),hwIndex,budget-rxCount)) > 0) ) {
+      handleCount += bCnt;
+      rxCount += bCnt;
+      eng->hwWrBuffCnt -= bCnt;
 
-      if ( dev->debug > 0 ) dev_info(dev->device,"Irq: Got RX Descriptor: Idx=%i, Pos=%i\n",ret.index,hwData->writeIndex);
+      for (x=0; x < bCnt; x++) {
+         if ( (buff = dmaGetBufferList(&(dev->rxBuffers),ret[x].index)) != NULL ) {
 
-      if ( (buff = dmaGetBufferList(&(dev->rxBuffers),ret.index)) != NULL ) {
-         buff->count++;
+            buff->count++;
 
-         buff->size  = ret.size;
-         buff->dest  = ret.dest;
-         buff->error = (ret.size == 0)?DMA_ERR_FIFO:ret.result;
+            buff->size  = ret[x].size;
+            buff->dest  = ret[x].dest;
+            buff->error = (ret[x].size == 0)?DMA_ERR_FIFO:ret[x].result;
 
-         buff->flags =  ret.fuser;                  // firstUser = flags[7:0]
-         buff->flags |= (ret.luser << 8) & 0x0FF00; // lastUser = flags[15:8]
-         buff->flags |= (ret.cont << 16) & 0x10000; // continue = flags[16]
+            // Nobody reads the dest, count and recycle without decoding flags or delivery
+            if ( (dev->secCount == 0) && ((ret[x].dest >= DMA_MAX_DEST) || (dev->desc[ret[x].dest] == NULL)) ) {
+               buff->flags = 0;
+               if ( debug > 0 ) Dma_Trace(dev,DMA_TRACE_RX,ret[x].index,ret[x].dest,ret[x].size,0,buff->error);
+               dmaRxIdleIrq(dev,buff);
+            }
+            else {
+               buff->flags =  ret[x].fuser;                  // firstUser = flags[7:0]
+               buff->flags |= (ret[x].luser << 8) & 0x0FF00; // lastUser = flags[15:8]
+               buff->flags |= (ret[x].cont << 16) & 0x10000; // continue = flags[16]
 
-         hwData->contCount += ret.cont;
+               eng->contCount += ret[x].cont;
 
-         if ( dev->debug > 0 ) {
-            dev_info(dev->device,"Irq: Rx size=%i, Dest=0x%x, fuser=0x%x, luser=0x%x, cont=%i, Error=0x%x\n",
-               ret.size, ret.dest, ret.fuser, ret.luser, ret.cont, buff->error);
-         }
+               if ( debug > 0 ) Dma_Trace(dev,DMA_TRACE_RX,ret[x].index,ret[x].dest,ret[x].size,buff->flags,buff->error);
 
-         // Find owner of lane/vc
-         if ( buff->dest < DMA_MAX_DEST ) desc = dev->desc[buff->dest];
-         else desc = NULL;
+               // Deliver to owner of lane/vc and secondary readers, a dropped frame is returned
+               buff = dmaRxDeliverIrq(dev,buff);
+            }
 
-         // Return entry to FPGA if desc is not open
-         if ( desc == NULL ) {
-            if ( dev->debug > 0 ) dev_info(dev->device,"Irq: Port not open return to free list.\n");
+            // Return entry to FPGA if desc is not open or frame was dropped
+            if ( buff != NULL ) {
+               if ( debug > 0 ) Dma_Trace(dev,DMA_TRACE_RX_RET,ret[x].index,ret[x].dest,ret[x].size,0,0);
 
-            if (hwData->hwWrBuffCnt < (hwData->addrCount-1)) {
-               AxisG2_WriteFree(buff,reg,hwData->desc128En);
-               ++hwData->hwWrBuffCnt;
+               if (eng->hwWrBuffCnt < (eng->addrCount-1)) {
+                  AxisG2_WriteFree(buff,eng,desc128En);
+                  ++eng->hwWrBuffCnt;
+                  ++refill;
+               }
+               else dmaQueuePushIrq(&(eng->wrQueue),buff);
             }
-            else dmaQueuePushIrq(&(hwData->wrQueue),buff);
          }
-
-         // lane/vc is open,  Add to RX Queue
-         else dmaRxBufferIrq(desc,buff);
+         else dev_warn(dev->device,"Irq: Failed to locate RX buffer index %i.\n", ret[x].index);
       }
-      else dev_warn(dev->device,"Irq: Failed to locate RX buffer index %i.\n", ret.index);
-
-      // Update index
-      hwData->writeIndex = ((hwData->writeIndex+1) % hwData->addrCount);
-
-      if ( handleCount > 2000 ) break;
    }
 
    // Unlock
+   spin_unlock(&eng->wrLock);
    spin_unlock(&dev->maskLock);
 
    // Get (write / receive) return buffer list
-   if ( hwData->desc128En && ((buffList = (struct DmaBuffer **)kmalloc(1000 * sizeof(struct DmaBuffer *),GFP_ATOMIC)) != NULL)) {
+   if ( desc128En && ((buffList = (struct DmaBuffer **)kmalloc(1000 * sizeof(struct DmaBuffer *),GFP_ATOMIC)) != NULL)) {
+      dmaSpinLock(&eng->wrLock,&eng->wrStats);
       do {
-         rCnt = ((hwData->addrCount-1) - hwData->hwWrBuffCnt);
+         rCnt = ((eng->addrCount-1) - eng->hwWrBuffCnt);
          if (rCnt > 1000 ) rCnt = 1000;
-         bCnt = dmaQueuePopListIrq(&(hwData->wrQueue),buffList,rCnt);
+         bCnt = dmaQueuePopListIrq(&(eng->wrQueue),buffList,rCnt);
          for (x=0; x < bCnt; x++) {
-            AxisG2_WriteFree(buffList[x],reg,hwData->desc128En);
-            ++hwData->hwWrBuffCnt;
+            AxisG2_WriteFree(buffList[x],eng,desc128En);
+            ++eng->hwWrBuffCnt;
          }
+         refill += bCnt;
       } while(bCnt > 0);
+      spin_unlock(&eng->wrLock);
 
       kfree(buffList);
    }
 
+   eng->ackCount += handleCount;
+   eng->rxCount  += rxCount;
+   eng->txCount  += txCount;
+   hwData->irqRx     += rxCount;
+   hwData->irqTx     += txCount;
+   hwData->irqRefill += refill;
+   return(handleCount);
+}
+
+// Specialized ring processing, selected at init
+uint32_t AxisG2_ProcessEngine64(struct DmaDevice *dev, struct AxisG2Data *hwData, struct AxisG2Engine *eng, uint32_t budget) {
+   return(AxisG2_ProcessEngineT(dev,hwData,eng,budget,0,0));
+}
+
+uint32_t AxisG2_ProcessEngine128(struct DmaDevice *dev, struct AxisG2Data *hwData, struct AxisG2Engine *eng, uint32_t budget) {
+   return(AxisG2_ProcessEngineT(dev,hwData,eng,budget,1,0));
+}
+
+uint32_t AxisG2_ProcessEngine64Debug(struct DmaDevice *dev, struct AxisG2Data *hwData, struct AxisG2Engine *eng, uint32_t budget) {
+   return(AxisG2_ProcessEngineT(dev,hwData,eng,budget,0,1));
+}
+
+uint32_t AxisG2_ProcessEngine128Debug(struct DmaDevice *dev, struct AxisG2Data *hwData, struct AxisG2Engine *eng, uint32_t budget) {
+   return(AxisG2_ProcessEngineT(dev,hwData,eng,budget,1,1));
+}
+
+// Process context transmit reclaim of a single engine, scans until an empty entry
+// Specialized for 64-bit and 128-bit descriptors
+static __always_inline uint32_t AxisG2_TxReapT(struct DmaDevice *dev, struct AxisG2Data *hwData, struct AxisG2Engine *eng,
+                                               const uint32_t desc128En) {
+   unsigned long iflags;
+   uint32_t * ptr;
+   uint32_t cnt;
+
+   // Nothing completed, no lock or register access
+   ptr = eng->readAddr + (eng->readIndex * (desc128En?4:2));
+   if ( (desc128En ? ptr[3] : ptr[1]) == 0 ) return(0);
+
+   dmaSpinLockIrqSave(&eng->rdLock,&eng->rdStats,iflags);
+   cnt = AxisG2_TxRingT(dev,hwData,eng,eng->addrCount,((eng->readIndex + eng->addrCount - 1) % eng->addrCount),desc128En,0);
+   eng->txCount  += cnt;
+   eng->txReaped += cnt;
+   spin_unlock_irqrestore(&eng->rdLock,iflags);
+   return(cnt);
+}
+
+uint32_t AxisG2_TxReapEngine64(struct DmaDevice *dev, struct AxisG2Data *hwData, struct AxisG2Engine *eng) {
+   return(AxisG2_TxReapT(dev,hwData,eng,0));
+}
+
+uint32_t AxisG2_TxReapEngine128(struct DmaDevice *dev, struct AxisG2Data *hwData, struct AxisG2Engine *eng) {
+   return(AxisG2_TxReapT(dev,hwData,eng,1));
+}
+
+// Reclaim transmit completions from process context, lazy reclaim mode
+void AxisG2_TxReap(struct DmaDevice *dev) {
+   struct AxisG2Data * hwData;
+
+   hwData = (struct AxisG2Data *)dev->hwData;
+   hwData->txReapEngine(dev,hwData,&(hwData->eng));
+}
+
+// Process rings, called with local interrupts disabled
+uint32_t AxisG2_Process(struct DmaDevice *dev, struct AxisG2Data *hwData, uint32_t budget) {
+   uint32_t handleCount;
+
+   // Debug flag is checked once per poll
+   if ( dmaDebug(dev) ) handleCount = hwData->procEngineDebug(dev,hwData,&(hwData->eng),budget);
+   else handleCount = hwData->procEngine(dev,hwData,&(hwData->eng),budget);
+
+   hwData->modRateFrames += handleCount;
+   return(handleCount);
+}
+
+// Enable interrupt and update ack count
+void AxisG2_Ack(struct AxisG2Data *hwData) {
+   iowrite32(0x30000 + hwData->eng.ackCount,&(hwData->eng.reg->intAckAndEnable));
+   hwData->eng.ackCount = 0;
+}
+
+// Count ready receive entries, up to max
+uint32_t AxisG2_RxReady(struct AxisG2Data *hwData, uint32_t max) {
+   struct AxisG2Engine * eng;
+   uint32_t * ptr;
+   uint32_t cnt;
+
+   eng = &(hwData->eng);
+
+   for (cnt=0; cnt < max; cnt++) {
+      ptr = eng->writeAddr + (((eng->writeIndex + cnt) % eng->addrCount) * (hwData->desc128En?4:2));
+      if ( (hwData->desc128En ? ptr[3] : ptr[1]) == 0 ) break;
+   }
+   return(cnt);
+}
+
+// Determine if interrupt service should be held off
+uint32_t AxisG2_Moderate(struct DmaDevice *dev, struct AxisG2Data *hwData) {
+
+   // Update observed rate, entries per second
+   if ( time_after_eq(jiffies,hwData->modRateTime + (HZ/10)) ) {
+      hwData->modRate = (hwData->modRateFrames * HZ) / (jiffies - hwData->modRateTime);
+      hwData->modRateFrames = 0;
+      hwData->modRateTime = jiffies;
+   }
+
+   if ( hwData->modHoldoff == 0 ) return(0);
+
+   // Adaptive mode, low rates are serviced immediately
+   if ( (hwData->modAdaptive != 0) && (hwData->modRate < hwData->modAdaptive) ) return(0);
+
+   // Enough frames are already waiting
+   if ( (hwData->modMinFrames != 0) && (AxisG2_RxReady(hwData,hwData->modMinFrames) >= hwData->modMinFrames) ) return(0);
+
+   return(1);
+}
+
+// Service rings or defer to irq thread, interrupt must be disabled
+irqreturn_t AxisG2_Service(struct DmaDevice *dev, struct AxisG2Data *hwData) {
+   uint32_t handleCount;
+   uint64_t start;
+
+   // Ring processing is deferred to irq thread, interrupt stays disabled until rings drain
+   if ( dev->cfgIrqBudget > 0 ) {
+      hwData->irqCount++;
+      return(IRQ_WAKE_THREAD);
+   }
+
+   start = ktime_get_ns();
+   hwData->irqRx     = 0;
+   hwData->irqTx     = 0;
+   hwData->irqRefill = 0;
+
+   handleCount = AxisG2_Process(dev,hwData,1000);
+
    // Enable interrupt and update ack count
-   iowrite32(0x30000 + handleCount,&(reg->intAckAndEnable));
-   if ( dev->debug > 0 ) dev_info(dev->device,"Irq: Done. Handled = %i\n",handleCount);
+   AxisG2_Ack(hwData);
+   dmaIrqRecord(dev,start,hwData->irqRx,hwData->irqTx,hwData->irqRefill);
+   if ( dmaDebug(dev) ) Dma_Trace(dev,DMA_TRACE_IRQ,0,0,handleCount,0,0);
    if ( handleCount == 0 ) hwData->missedIrq++;
    return(IRQ_HANDLED);
 }
 
+// Moderation holdoff timer, interrupt is still disabled
+enum hrtimer_restart AxisG2_ModTimer(struct hrtimer *timer) {
+   struct AxisG2Data * hwData;
+   struct DmaDevice  * dev;
+   unsigned long iflags;
+   irqreturn_t ret;
+
+   hwData = container_of(timer,struct AxisG2Data,modTimer);
+   dev    = hwData->dev;
+
+   spin_lock_irqsave(&(hwData->modLock),iflags);
+
+   // Handler serviced and started a new holdoff while waiting for lock, that expiry services
+   if ( hrtimer_is_queued(timer) ) {
+      spin_unlock_irqrestore(&(hwData->modLock),iflags);
+      return(HRTIMER_NORESTART);
+   }
+
+   hwData->modDeferred++;
+   ret = AxisG2_Service(dev,hwData);
+   spin_unlock_irqrestore(&(hwData->modLock),iflags);
+
+   if ( ret == IRQ_WAKE_THREAD ) irq_wake_thread(dev->irq,dev);
+
+   return(HRTIMER_NORESTART);
+}
+
+// Interrupt handler
+irqreturn_t AxisG2_Irq(int irq, void *dev_id) {
+   struct DmaDevice   * dev;
+   struct AxisG2Data  * hwData;
+   irqreturn_t ret;
+
+   dev    = (struct DmaDevice *)dev_id;
+   hwData = (struct AxisG2Data *)dev->hwData;
+
+   spin_lock(&(hwData->modLock));
+
+   // Holdoff pending, interrupt is already disabled and the line is shared,
+   // never push the pending service back
+   if ( hrtimer_is_queued(&(hwData->modTimer)) ) {
+      spin_unlock(&(hwData->modLock));
+      return(IRQ_HANDLED);
+   }
+
+   // Disable interrupt
+   iowrite32(0x0,&(hwData->eng.reg->intEnable));
+
+   // Hold off service, interrupt stays disabled until timer expires
+   if ( AxisG2_Moderate(dev,hwData) ) {
+      hrtimer_start(&(hwData->modTimer),ns_to_ktime((uint64_t)hwData->modHoldoff * 1000),HRTIMER_MODE_REL);
+      ret = IRQ_HANDLED;
+   }
+   else ret = AxisG2_Service(dev,hwData);
+
+   spin_unlock(&(hwData->modLock));
+   return(ret);
+}
+
+// Threaded interrupt handler
+// Rings are processed in polls of at most budget entries per ring until drained
+irqreturn_t AxisG2_IrqThread(int irq, void *dev_id) {
+   uint32_t handleCount;
+   uint32_t total;
+   uint64_t start;
+   unsigned long iflags;
+
+   struct DmaDevice   * dev;
+   struct AxisG2Data  * hwData;
+
+   dev    = (struct DmaDevice *)dev_id;
+   hwData = (struct AxisG2Data *)dev->hwData;
+
+   total = 0;
+   start = ktime_get_ns();
+   hwData->irqRx     = 0;
+   hwData->irqTx     = 0;
+   hwData->irqRefill = 0;
+
+   do {
+      local_irq_save(iflags);
+      handleCount = AxisG2_Process(dev,hwData,dev->cfgIrqBudget);
+      local_irq_restore(iflags);
+
+      total += handleCount;
+      hwData->pollCount++;
+      hwData->workCount += handleCount;
+      if ( handleCount > hwData->maxWork ) hwData->maxWork = handleCount;
+
+      // Rings are drained, or next poll could overflow ack count,
+      // lazy transmit acks may cover a full ring
+      if ( (handleCount < dev->cfgIrqBudget) ||
+           ((total + 2*dev->cfgIrqBudget + ((dev->cfgTxLazy > 0)?4096:0)) > 0xFFFF) ) break;
+
+      cond_resched();
+   } while (1);
+
+   // Enable interrupt and update ack count
+   AxisG2_Ack(hwData);
+   dmaIrqRecord(dev,start,hwData->irqRx,hwData->irqTx,hwData->irqRefill);
+   if ( dmaDebug(dev) ) Dma_Trace(dev,DMA_TRACE_IRQ,1,0,total,0,0);
+   if ( total == 0 ) hwData->missedIrq++;
+   return(IRQ_HANDLED);
+}
+
+
 // Init card in top level Probe
 void AxisG2_Init(struct DmaDevice *dev) {
    uint32_t x;
    uint32_t size;
+   uint32_t cache;
 
-   struct DmaBuffer  *buff;
-   struct AxisG2Data *hwData;
-   struct AxisG2Reg  *reg;
+   struct DmaBuffer    *buff;
+   struct AxisG2Data   *hwData;
+   struct AxisG2Engine *eng;
+   struct AxisG2Reg    *reg;
 
    reg = (struct AxisG2Reg *)dev->reg;
 
@@ -293,62 +740,173 @@ void AxisG2_Init(struct DmaDevice *dev) {
    // Init hw data
    hwData = (struct AxisG2Data *)kmalloc(sizeof(struct AxisG2Data),GFP_KERNEL);
    dev->hwData = hwData;
+   hwData->dev = dev;
 
    // 64-bit or 128-bit mode
    hwData->desc128En = ((ioread32(&(reg->enableVer)) & 0x10000) != 0);
 
+   // Install handlers specialized for descriptor format in a per device table
+   hwData->baseFunc = dev->hwFunc;
+   memcpy(&(hwData->hwFunc),dev->hwFunc,sizeof(struct hardware_functions));
+
+   if ( hwData->desc128En ) {
+      hwData->procEngine      = AxisG2_ProcessEngine128;
+      hwData->procEngineDebug = AxisG2_ProcessEngine128Debug;
+      hwData->txReapEngine    = AxisG2_TxReapEngine128;
+      if ( hwData->hwFunc.retRxBuffer == AxisG2_RetRxBuffer ) hwData->hwFunc.retRxBuffer = AxisG2_RetRxBuffer128;
+      if ( hwData->hwFunc.sendBuffer  == AxisG2_SendBuffer  ) hwData->hwFunc.sendBuffer  = AxisG2_SendBuffer128;
+   }
+   else {
+      hwData->procEngine      = AxisG2_ProcessEngine64;
+      hwData->procEngineDebug = AxisG2_ProcessEngine64Debug;
+      hwData->txReapEngine    = AxisG2_TxReapEngine64;
+      if ( hwData->hwFunc.retRxBuffer == AxisG2_RetRxBuffer ) hwData->hwFunc.retRxBuffer = AxisG2_RetRxBuffer64;
+      if ( hwData->hwFunc.sendBuffer  == AxisG2_SendBuffer  ) hwData->hwFunc.sendBuffer  = AxisG2_SendBuffer64;
+   }
+
+   // Lazy transmit reclaim from process context
+   if ( dev->cfgTxLazy > 0 ) hwData->hwFunc.txReap = AxisG2_TxReap;
+   dev->hwFunc = &(hwData->hwFunc);
+
+   // Firmware does not report additional engine register blocks
+   if ( dev->cfgEngines > 1 )
+      dev_warn(dev->device,"Init: Firmware does not report engine locations, cfgEngines=%i refused, using 1.\n",dev->cfgEngines);
+
+   eng = &(hwData->eng);
+   eng->reg = reg;
+   spin_lock_init(&(eng->rdLock));
+   spin_lock_init(&(eng->wrLock));
+   memset(&(eng->rdStats),0,sizeof(struct DmaLockStats));
+   memset(&(eng->wrStats),0,sizeof(struct DmaLockStats));
+
    // Keep track of the number of buffers in hardware
-   hwData->hwWrBuffCnt = 0;
-   hwData->hwRdBuffCnt = 0;
+   eng->hwWrBuffCnt = 0;
+   eng->hwRdBuffCnt = 0;
 
    // Init software buffer queues for 128bit mode
    if ( hwData->desc128En ) {
-      dmaQueueInit(&hwData->wrQueue,dev->rxBuffers.count);
-      dmaQueueInit(&hwData->rdQueue,dev->txBuffers.count + dev->rxBuffers.count);
+      dmaQueueInit(&eng->wrQueue,dev->rxBuffers.count);
+      for (cache=0; cache < AXIS_TX_CLASSES; cache++) {
+         dmaQueueInit(&eng->txq[cache].q,dev->txBuffers.count + dev->rxBuffers.count);
+         eng->txq[cache].maxDepth  = 0;
+         eng->txq[cache].frames    = 0;
+         eng->txq[cache].waitNs    = 0;
+         eng->txq[cache].maxWaitNs = 0;
+      }
+      eng->txQueued = 0;
+      eng->txRr     = 0;
+      eng->txCredit = 1;
    }
 
    // Set read and write ring buffers
-   hwData->addrCount = (1 << ioread32(&(reg->addrWidth)));
+   eng->addrCount = (1 << ioread32(&(eng->reg->addrWidth)));
 
    // Set alloc size
-   size = hwData->addrCount*(hwData->desc128En?16:8);
+   size = eng->addrCount*(hwData->desc128En?16:8);
 
    if(dev->cfgMode & AXIS2_RING_ACP) {
-      hwData->readAddr   = kmalloc(size, GFP_DMA | GFP_KERNEL);
-      hwData->readHandle = virt_to_phys(hwData->readAddr);
+      eng->readAddr   = kmalloc(size, GFP_DMA | GFP_KERNEL);
+      eng->readHandle = virt_to_phys(eng->readAddr);
 
-      hwData->writeAddr   = kmalloc(size, GFP_DMA | GFP_KERNEL);
-      hwData->writeHandle = virt_to_phys(hwData->writeAddr);
+      eng->writeAddr   = kmalloc(size, GFP_DMA | GFP_KERNEL);
+      eng->writeHandle = virt_to_phys(eng->writeAddr);
    }
    else {
-      hwData->readAddr = dma_alloc_coherent(dev->device, size, &(hwData->readHandle), GFP_DMA32 | GFP_KERNEL);
-      hwData->writeAddr = dma_alloc_coherent(dev->device, size, &(hwData->writeHandle), GFP_DMA32 | GFP_KERNEL);
+      eng->readAddr = dma_alloc_coherent(dev->device, size, &(eng->readHandle), GFP_DMA32 | GFP_KERNEL);
+      eng->writeAddr = dma_alloc_coherent(dev->device, size, &(eng->writeHandle), GFP_DMA32 | GFP_KERNEL);
    }
 
-   dev_info(dev->device,"Init: Read  ring at: sw 0x%llx -> hw 0x%llx.\n",(uint64_t)hwData->readAddr,(uint64_t)hwData->readHandle);
-   dev_info(dev->device,"Init: Write ring at: sw 0x%llx -> hw 0x%llx.\n",(uint64_t)hwData->writeAddr,(uint64_t)hwData->writeHandle);
+   dev_info(dev->device,"Init: Read  ring at: sw 0x%llx -> hw 0x%llx.\n",(uint64_t)eng->readAddr,(uint64_t)eng->readHandle);
+   dev_info(dev->device,"Init: Write ring at: sw 0x%llx -> hw 0x%llx.\n",(uint64_t)eng->writeAddr,(uint64_t)eng->writeHandle);
 
    // Init and set ring address
-   iowrite32(hwData->readHandle&0xFFFFFFFF,&(reg->rdBaseAddrLow));
-   iowrite32((hwData->readHandle >> 32)&0xFFFFFFFF,&(reg->rdBaseAddrHigh));
-   memset(hwData->readAddr,0,size);
-   hwData->readIndex = 0;
+   iowrite32(eng->readHandle&0xFFFFFFFF,&(eng->reg->rdBaseAddrLow));
+   iowrite32((eng->readHandle >> 32)&0xFFFFFFFF,&(eng->reg->rdBaseAddrHigh));
+   memset(eng->readAddr,0,size);
+   eng->readIndex = 0;
 
    // Init and set ring address
-   iowrite32(hwData->writeHandle&0xFFFFFFFF,&(reg->wrBaseAddrLow));
-   iowrite32((hwData->writeHandle>>32)&0xFFFFFFFF,&(reg->wrBaseAddrHigh));
-   memset(hwData->writeAddr,0,size);
-   hwData->writeIndex = 0;
+   iowrite32(eng->writeHandle&0xFFFFFFFF,&(eng->reg->wrBaseAddrLow));
+   iowrite32((eng->writeHandle>>32)&0xFFFFFFFF,&(eng->reg->wrBaseAddrHigh));
+   memset(eng->writeAddr,0,size);
+   eng->writeIndex = 0;
+
+   eng->contCount  = 0;
+   eng->ackCount   = 0;
+   eng->rxCount    = 0;
+   eng->txCount    = 0;
+   eng->txAckIndex = 0;
+   eng->txReaped   = 0;
+
+   // Descriptor posting, 64-bit writes where the platform has them
+#ifdef writeq
+   eng->postWide = ((dev->cfgDescPost & AXIS2_POST_WIDE) != 0);
+#else
+   eng->postWide = 0;
+   if ( dev->cfgDescPost & AXIS2_POST_WIDE ) dev_warn(dev->device,"Init: 64-bit descriptor posting not supported.\n");
+#endif
+
+   // Address table is only used in 64-bit mode
+   eng->addrTable   = eng->reg->dmaAddr;
+   eng->addrTableWc = 0;
+
+   if ( (!hwData->desc128En) && (dev->cfgDescPost & AXIS2_POST_WC) ) {
+      eng->addrTable = (uint32_t *)ioremap_wc(dev->baseAddr + ((uint8_t *)eng->reg->dmaAddr - (uint8_t *)dev->base),
+                                              sizeof(eng->reg->dmaAddr));
+      if ( eng->addrTable == NULL ) {
+         dev_warn(dev->device,"Init: Failed to map write combined address table.\n");
+         eng->addrTable = eng->reg->dmaAddr;
+      }
+      else eng->addrTableWc = 1;
+   }
 
    hwData->missedIrq = 0;
-   hwData->contCount = 0;
+   hwData->irqCount  = 0;
+   hwData->pollCount = 0;
+   hwData->workCount = 0;
+   hwData->maxWork   = 0;
+
+   // Limit budget so a single poll fits in ack count
+   if ( dev->cfgIrqBudget > 4096 ) dev->cfgIrqBudget = 4096;
+
+   // Moderation disabled by default
+   hrtimer_init(&(hwData->modTimer),CLOCK_MONOTONIC,HRTIMER_MODE_REL);
+   hwData->modTimer.function = AxisG2_ModTimer;
+   spin_lock_init(&(hwData->modLock));
+   hwData->modMinFrames  = 0;
+   hwData->modHoldoff    = 0;
+   hwData->modAdaptive   = 0;
+   hwData->modRate       = 0;
+   hwData->modRateFrames = 0;
+   hwData->modRateTime   = jiffies;
+   hwData->modDeferred   = 0;
+
+   // No dests paced
+   spin_lock_init(&(hwData->paceLock));
+   hrtimer_init(&(hwData->paceTimer),CLOCK_MONOTONIC,HRTIMER_MODE_ABS);
+   hwData->paceTimer.function = AxisG2_PaceTimer;
+   hwData->paceSlot  = kzalloc(DMA_MAX_DEST,GFP_KERNEL);
+   hwData->paceCount = 0;
+   for (x=0; x < AXIS2_PACE_MAX; x++) {
+      hwData->pace[x].used = 0;
+      hwData->pace[x].head = NULL;
+      dmaQueueInit(&(hwData->pace[x].q),dev->txBuffers.count + dev->rxBuffers.count);
+   }
+
+   // All dests in class 0, single weighted class behaves as one fifo
+   hwData->txClass = kzalloc(DMA_MAX_DEST,GFP_KERNEL);
+   for (x=0; x < AXIS_TX_CLASSES; x++) {
+      hwData->txStrict[x] = 0;
+      hwData->txWeight[x] = 1;
+   }
 
    // Set cache mode, bits3:0 = descWr, bits 11:8 = bufferWr, bits 15:12 = bufferRd
-   x = 0;
-   if ( dev->cfgMode & BUFF_ARM_ACP   ) x |= 0xA600; // Buffer
-   if ( dev->cfgMode & AXIS2_RING_ACP ) x |= 0x00A6; // Desc
-   iowrite32(x,&(reg->cacheConfig));
-   
+   cache = 0;
+   if ( dev->cfgMode & BUFF_ARM_ACP   ) cache |= 0xA600; // Buffer
+   if ( dev->cfgMode & AXIS2_RING_ACP ) cache |= 0x00A6; // Desc
+
+   iowrite32(cache,&(reg->cacheConfig));
+
    // Set MAX RX                      
    iowrite32(dev->cfgSize,&(reg->maxSize));
 
@@ -356,9 +914,9 @@ void AxisG2_Init(struct DmaDevice *dev) {
    iowrite32(0x1,&(reg->fifoReset)); 
    iowrite32(0x0,&(reg->fifoReset)); 
 
-   // Continue and drop
+   // Continue and drop, hardware drop discards frames when no free buffer is posted
    iowrite32(0x1,&(reg->contEnable)); 
-   iowrite32(0x0,&(reg->dropEnable)); 
+   iowrite32((dev->cfgDrop)?0x1:0x0,&(reg->dropEnable)); 
 
    // Push RX buffers to hardware and map
    for (x=dev->rxBuffers.baseIdx; x < (dev->rxBuffers.baseIdx + dev->rxBuffers.count); x++) {
@@ -368,13 +926,13 @@ void AxisG2_Init(struct DmaDevice *dev) {
       if ( dmaBufferToHw(buff) < 0 ) dev_warn(dev->device,"Init: Failed to map dma buffer.\n");
 
       // Add to software queue, if enabled and hardware is full
-      else if ( hwData->desc128En && (hwData->hwWrBuffCnt >= (hwData->addrCount-1)) ) 
-         dmaQueuePush(&(hwData->wrQueue),buff);
+      else if ( hwData->desc128En && (eng->hwWrBuffCnt >= (eng->addrCount-1)) ) 
+         dmaQueuePush(&(eng->wrQueue),buff);
 
       // Add to hardware queue
       else {
-         ++hwData->hwWrBuffCnt;
-         AxisG2_WriteFree(buff,reg,hwData->desc128En);
+         ++eng->hwWrBuffCnt;
+         AxisG2_WriteFree(buff,eng,hwData->desc128En);
       }
    }
 
@@ -384,9 +942,11 @@ void AxisG2_Init(struct DmaDevice *dev) {
 
 // Enable the card
 void AxisG2_Enable(struct DmaDevice *dev) {
+   struct AxisG2Data *hwData;
    struct AxisG2Reg  *reg;
 
-   reg = (struct AxisG2Reg *)dev->reg;
+   hwData = (struct AxisG2Data *)dev->hwData;
+   reg = hwData->eng.reg;
 
    // Enable
    iowrite32(0x1,&(reg->enableVer));
@@ -400,111 +960,550 @@ void AxisG2_Enable(struct DmaDevice *dev) {
 
 // Clear card in top level Remove
 void AxisG2_Clear(struct DmaDevice *dev) {
-   struct AxisG2Reg *reg;
+   struct AxisG2Engine * eng;
    struct AxisG2Data * hwData;
+   uint32_t size;
+   uint32_t x;
 
-   reg = (struct AxisG2Reg *)dev->reg;
    hwData = (struct AxisG2Data *)dev->hwData;
 
+   // Mask interrupts and wait for running hard and threaded handlers
+   iowrite32(0x0,&(hwData->eng.reg->intEnable));
+   if ( dev->irq != 0 ) synchronize_irq(dev->irq);
+
+   // Stop holdoff timer, an expired timer may have re-enabled the
+   // interrupt or woken the irq thread so mask and wait again
+   hrtimer_cancel(&(hwData->modTimer));
+   iowrite32(0x0,&(hwData->eng.reg->intEnable));
+   if ( dev->irq != 0 ) synchronize_irq(dev->irq);
+
+   // Stop pacing once handlers are idle, waiting frames are dropped with the buffer lists
+   hrtimer_cancel(&(hwData->paceTimer));
+   for (x=0; x < AXIS2_PACE_MAX; x++) dmaQueueFree(&(hwData->pace[x].q));
+   kfree(hwData->paceSlot);
+
+   eng = &(hwData->eng);
+
    // Disable interrupt
-   iowrite32(0x0,&(reg->intEnable));
+   iowrite32(0x0,&(eng->reg->intEnable));
 
    // Disable rx and tx
-   iowrite32(0x0,&(reg->enableVer));
-   iowrite32(0x0,&(reg->online));
+   iowrite32(0x0,&(eng->reg->enableVer));
+   iowrite32(0x0,&(eng->reg->online));
 
    // Clear FIFOs
-   iowrite32(0x1,&(reg->fifoReset));
+   iowrite32(0x1,&(eng->reg->fifoReset));
 
    // Free buffers
+   size = eng->addrCount*(hwData->desc128En?16:8);
+
    if(dev->cfgMode & AXIS2_RING_ACP) {
-      kfree(hwData->readAddr);
-      kfree(hwData->writeAddr);
+      kfree(eng->readAddr);
+      kfree(eng->writeAddr);
    }
    else {
-      dma_free_coherent(dev->device, hwData->addrCount*8, hwData->writeAddr, hwData->writeHandle);
-      dma_free_coherent(dev->device, hwData->addrCount*8, hwData->readAddr, hwData->readHandle);
+      dma_free_coherent(dev->device, size, eng->writeAddr, eng->writeHandle);
+      dma_free_coherent(dev->device, size, eng->readAddr, eng->readHandle);
+   }
+
+   // Free software queues
+   if ( hwData->desc128En ) {
+      dmaQueueFree(&(eng->wrQueue));
+      for (size=0; size < AXIS_TX_CLASSES; size++) dmaQueueFree(&(eng->txq[size].q));
    }
 
+   if ( eng->addrTableWc ) iounmap(eng->addrTable);
+
+   // Restore shared handler table before per device copy is freed
+   dev->hwFunc = hwData->baseFunc;
+   kfree(hwData->txClass);
    kfree(hwData);
 }
 
-// Return buffer list to card
+// Return buffer list to card, dispatch on descriptor format
 void AxisG2_RetRxBuffer(struct DmaDevice *dev, struct DmaBuffer **buff, uint32_t count) {
-   struct AxisG2Reg *reg;
+   if ( ((struct AxisG2Data *)dev->hwData)->desc128En ) AxisG2_RetRxBuffer128(dev,buff,count);
+   else AxisG2_RetRxBuffer64(dev,buff,count);
+}
+
+// Return buffer list to card, 64-bit descriptors are written directly, no lock required
+void AxisG2_RetRxBuffer64(struct DmaDevice *dev, struct DmaBuffer **buff, uint32_t count) {
    struct AxisG2Data *hwData;
    uint32_t x;
 
-   reg = (struct AxisG2Reg *)dev->reg;
    hwData = (struct AxisG2Data *)dev->hwData;
 
-   // Prep for hardware
    for (x =0; x < count; x++) {
       if ( dmaBufferToHw(buff[x]) < 0 ) {
          dev_warn(dev->device,"RetRxBuffer: Failed to map dma buffer.\n");
          return;
       }
-
-      // Write to hardware if 64-bit desc, no lock required
-      if ( ! hwData->desc128En ) AxisG2_WriteFree(buff[x],reg,hwData->desc128En);
+      AxisG2_WriteFree(buff[x],&(hwData->eng),0);
    }
+}
 
-   // Push to software queue for 128bit desc, force an interrupt
-   if ( hwData->desc128En ) {
-      dmaQueuePushList(&(hwData->wrQueue),buff,count);
-      iowrite32(0x1,&(reg->forceInt));
+// Return buffer list to card, 128-bit descriptors are posted directly,
+// force an interrupt only if the ring was full
+void AxisG2_RetRxBuffer128(struct DmaDevice *dev, struct DmaBuffer **buff, uint32_t count) {
+   struct AxisG2Data *hwData;
+   uint32_t x;
+
+   hwData = (struct AxisG2Data *)dev->hwData;
+
+   // Prep for hardware
+   for (x =0; x < count; x++) {
+      if ( dmaBufferToHw(buff[x]) < 0 ) {
+         dev_warn(dev->device,"RetRxBuffer: Failed to map dma buffer.\n");
+         return;
+      }
    }
+
+   if ( AxisG2_PostFree(hwData,&(hwData->eng),buff,count) > 0 )
+      iowrite32(0x1,&(hwData->eng.reg->forceInt));
 }
 
-// Send a buffer
+// Send a buffer, dispatch on descriptor format
 int32_t AxisG2_SendBuffer(struct DmaDevice *dev, struct DmaBuffer **buff, uint32_t count) {
+   if ( ((struct AxisG2Data *)dev->hwData)->desc128En ) return(AxisG2_SendBuffer128(dev,buff,count));
+   else return(AxisG2_SendBuffer64(dev,buff,count));
+}
+
+// Send a buffer, 64-bit descriptors are written directly under the ring lock
+int32_t AxisG2_SendBuffer64(struct DmaDevice *dev, struct DmaBuffer **buff, uint32_t count) {
+   struct AxisG2Engine * eng;
    struct AxisG2Data * hwData;
-   struct AxisG2Reg *reg;
    unsigned long iflags;
+   uint32_t x;
 
+   hwData = (struct AxisG2Data *)dev->hwData;
+
+   // Lazy reclaim on send
+   if ( dev->cfgTxLazy > 0 ) AxisG2_TxReap(dev);
+
+   for (x =0; x < count; x++) {
+      if ( dmaBufferToHw(buff[x]) < 0 ) {
+         dev_warn(dev->device,"SendBuffer: Failed to map dma buffer.\n");
+         return(-1);
+      }
+
+      // Paced dest
+      if ( (hwData->paceCount > 0) && AxisG2_Pace(hwData,buff[x]) ) continue;
+
+      eng = &(hwData->eng);
+      dmaSpinLockIrqSave(&eng->rdLock,&eng->rdStats,iflags);
+      AxisG2_WriteTx(buff[x],eng,0);
+      spin_unlock_irqrestore(&eng->rdLock,iflags);
+   }
+   return(count);
+}
+
+// Send a buffer, 128-bit descriptors are posted directly,
+// force an interrupt only if the ring was full
+int32_t AxisG2_SendBuffer128(struct DmaDevice *dev, struct DmaBuffer **buff, uint32_t count) {
+   struct AxisG2Data * hwData;
+   uint32_t queued;
    uint32_t x;
 
-   reg = (struct AxisG2Reg *)dev->reg;
    hwData = (struct AxisG2Data *)dev->hwData;
 
+   // Lazy reclaim on send, frees ring space before posting
+   if ( dev->cfgTxLazy > 0 ) AxisG2_TxReap(dev);
+
    // Prep for hardware
    for (x =0; x < count; x++) {
       if ( dmaBufferToHw(buff[x]) < 0 ) {
          dev_warn(dev->device,"SendBuffer: Failed to map dma buffer.\n");
          return(-1);
       }
+   }
 
-      // Write directly to hardware for 64-bit desc
-      if ( ! hwData->desc128En ) {
-         spin_lock_irqsave(&dev->writeHwLock,iflags);
-         AxisG2_WriteTx(buff[x],reg,hwData->desc128En);
-         spin_unlock_irqrestore(&dev->writeHwLock,iflags);
+   if ( hwData->paceCount == 0 ) queued = AxisG2_PostTx(hwData,&(hwData->eng),buff,count);
+   else {
+      queued = 0;
+      for (x=0; x < count; x++) {
+         if ( AxisG2_Pace(hwData,buff[x]) ) continue;
+         queued += AxisG2_PostTx(hwData,&(hwData->eng),&(buff[x]),1);
       }
    }
 
-   // Push to software queue for 128bit desc, force an interrupt
-   if ( hwData-> desc128En ) {
-      dmaQueuePushList(&(hwData->rdQueue),buff,count);
-      iowrite32(0x1,&(reg->forceInt));
-   }
+   if ( queued > 0 ) iowrite32(0x1,&(hwData->eng.reg->forceInt));
    return(count);
 }
 
+// Descriptor posting benchmark
+// Spare registers absorb the descriptor sized bursts, a read back flushes posted writes.
+// Address table entries of receive buffers are rewritten with their fixed coherent handles.
+// Only run while the engines are quiet, returns -EBUSY otherwise.
+int32_t AxisG2_PostBench(struct DmaDevice *dev, struct AxisG2Data *hwData, struct AxisPostBench *bench) {
+   struct AxisG2Engine * eng;
+   struct DmaBuffer    * buff;
+   unsigned long iflags;
+   ktime_t start;
+   uint32_t busy;
+   uint32_t x;
+
+   // Calling descriptor must be the only one open
+   dmaSpinLock(&dev->descLock,&dev->descStats);
+   busy = ! list_is_singular(&(dev->descList));
+   spin_unlock(&dev->descLock);
+
+   // No dest may be enabled
+   dmaSpinLockIrqSave(&dev->maskLock,&dev->maskStats,iflags);
+   for (x=0; (x < DMA_MAX_DEST) && (! busy); x++)
+      if ( dev->desc[x] != NULL ) busy = 1;
+   spin_unlock_irqrestore(&dev->maskLock,iflags);
+
+   // No transmit frame may be in flight
+   for (x=0; (x < dev->txBuffers.count) && (! busy); x++) {
+      buff = dmaGetBufferList(&(dev->txBuffers),dev->txBuffers.baseIdx + x);
+      if ( buff->inHw ) busy = 1;
+   }
+
+   if ( busy ) {
+      dev_warn(dev->device,"PostBench: Device is active.\n");
+      return(-EBUSY);
+   }
+
+   eng = &(hwData->eng);
+
+   if ( (bench->count == 0) || (bench->count > 1000000) ) bench->count = 1000000;
+
+   // Four 32-bit writes per descriptor
+   start = ktime_get();
+   for (x=0; x < bench->count; x++) {
+      iowrite32(x,&(eng->reg->spareB[1]));
+      iowrite32(x,&(eng->reg->spareB[0]));
+      iowrite32(x,&(eng->reg->spareB[1]));
+      iowrite32(x,&(eng->reg->spareB[0]));
+   }
+   ioread32(&(eng->reg->spareB[0]));
+   bench->narrowNs = ktime_to_ns(ktime_sub(ktime_get(),start));
+
+   // Two 64-bit writes per descriptor
+   bench->wideNs = 0;
+#ifdef writeq
+   start = ktime_get();
+   for (x=0; x < bench->count; x++) {
+      writeq(x,&(eng->reg->spareB[0]));
+      writeq(x,&(eng->reg->spareB[0]));
+   }
+   ioread32(&(eng->reg->spareB[0]));
+   bench->wideNs = ktime_to_ns(ktime_sub(ktime_get(),start));
+#endif
+
+   // Address table, entries only stay fixed for coherent buffers in 64-bit mode
+   bench->tableNs   = 0;
+   bench->tableWcNs = 0;
+   if ( hwData->desc128En || (dev->cfgMode != BUFF_COHERENT) || (dev->rxBuffers.count == 0) ) return(0);
+
+   start = ktime_get();
+   for (x=0; x < bench->count; x++) {
+      buff = dmaGetBufferList(&(dev->rxBuffers),dev->rxBuffers.baseIdx + (x % dev->rxBuffers.count));
+      iowrite32(buff->buffHandle,&(eng->reg->dmaAddr[buff->index]));
+   }
+   ioread32(&(hwData->eng.reg->spareB[0]));
+   bench->tableNs = ktime_to_ns(ktime_sub(ktime_get(),start));
+
+   if ( ! hwData->eng.addrTableWc ) return(0);
+
+   start = ktime_get();
+   for (x=0; x < bench->count; x++) {
+      buff = dmaGetBufferList(&(dev->rxBuffers),dev->rxBuffers.baseIdx + (x % dev->rxBuffers.count));
+      iowrite32(buff->buffHandle,&(eng->addrTable[buff->index]));
+      wmb();
+   }
+   ioread32(&(hwData->eng.reg->spareB[0]));
+   bench->tableWcNs = ktime_to_ns(ktime_sub(ktime_get(),start));
+   return(0);
+}
+
+// Post a single transmit buffer outside of pacing
+void AxisG2_PaceSend(struct AxisG2Data *hwData, struct DmaBuffer *buff) {
+   struct AxisG2Engine * eng;
+   unsigned long iflags;
+
+   eng = &(hwData->eng);
+
+   if ( hwData->desc128En ) {
+      if ( AxisG2_PostTx(hwData,eng,&buff,1) > 0 ) iowrite32(0x1,&(eng->reg->forceInt));
+   }
+   else {
+      dmaSpinLockIrqSave(&eng->rdLock,&eng->rdStats,iflags);
+      AxisG2_WriteTx(buff,eng,0);
+      spin_unlock_irqrestore(&eng->rdLock,iflags);
+   }
+}
+
+// Earliest release time of next frame for pacing slot
+static inline uint64_t AxisG2_PaceTime(struct AxisG2Pace *pace) {
+   uint64_t ft;
+   uint64_t bt;
+
+   ft = (pace->frameNext > pace->frameTau) ? (pace->frameNext - pace->frameTau) : 0;
+   bt = (pace->byteNext  > pace->byteTau)  ? (pace->byteNext  - pace->byteTau)  : 0;
+   return((ft > bt) ? ft : bt);
+}
+
+// Charge frame to pacing slot starting at base time
+static inline void AxisG2_PaceCharge(struct AxisG2Pace *pace, struct DmaBuffer *buff, uint64_t base) {
+   if ( pace->frameRate > 0 )
+      pace->frameNext = ((pace->frameNext > base) ? pace->frameNext : base) + pace->frameNs;
+   if ( pace->byteRate > 0 )
+      pace->byteNext = ((pace->byteNext > base) ? pace->byteNext : base) + div64_u64((uint64_t)buff->size * 1000000000ULL,pace->byteRate);
+   pace->frames++;
+}
+
+// Arm release timer for absolute time, keeps an earlier pending expiry
+static inline void AxisG2_PaceArm(struct AxisG2Data *hwData, uint64_t time) {
+   if ( (!hrtimer_is_queued(&(hwData->paceTimer))) || (time < ktime_to_ns(hrtimer_get_expires(&(hwData->paceTimer)))) )
+      hrtimer_start(&(hwData->paceTimer),ns_to_ktime(time),HRTIMER_MODE_ABS);
+}
+
+// Pace transmit buffer, returns 1 if buffer was taken by pacing
+// Frames go out directly while the dest has nothing waiting and its buckets allow it
+uint32_t AxisG2_Pace(struct AxisG2Data *hwData, struct DmaBuffer *buff) {
+   struct AxisG2Pace * pace;
+   unsigned long iflags;
+   uint64_t now;
+   uint64_t time;
+   uint32_t slot;
+
+   spin_lock_irqsave(&(hwData->paceLock),iflags);
+
+   slot = ((hwData->paceSlot != NULL) && (buff->dest < DMA_MAX_DEST)) ? hwData->paceSlot[buff->dest] : 0;
+   if ( slot == 0 ) {
+      spin_unlock_irqrestore(&(hwData->paceLock),iflags);
+      return(0);
+   }
+   pace = &(hwData->pace[slot-1]);
+   now  = ktime_get_ns();
+
+   if ( pace->head == NULL ) {
+      if ( (time = AxisG2_PaceTime(pace)) <= now ) {
+         AxisG2_PaceCharge(pace,buff,now);
+         AxisG2_PaceSend(hwData,buff);
+      }
+      else {
+         pace->head = buff;
+         pace->delayed++;
+         AxisG2_PaceArm(hwData,time);
+      }
+   }
+   // Rx buffers may be sent too, a full queue sends the frame unpaced rather than losing it
+   else if ( dmaQueuePushIrq(&(pace->q),buff) ) AxisG2_PaceSend(hwData,buff);
+   else pace->delayed++;
+
+   spin_unlock_irqrestore(&(hwData->paceLock),iflags);
+   return(1);
+}
+
+// Pacing release timer
+// Waiting frames are charged from their scheduled time so timer latency does not lower the rate
+enum hrtimer_restart AxisG2_PaceTimer(struct hrtimer *timer) {
+   struct AxisG2Data * hwData;
+   struct AxisG2Pace * pace;
+   unsigned long iflags;
+   uint64_t next;
+   uint64_t now;
+   uint64_t time;
+   uint32_t x;
+
+   hwData = container_of(timer,struct AxisG2Data,paceTimer);
+
+   spin_lock_irqsave(&(hwData->paceLock),iflags);
+   now  = ktime_get_ns();
+   next = 0;
+
+   for (x=0; x < AXIS2_PACE_MAX; x++) {
+      pace = &(hwData->pace[x]);
+      if ( ! pace->used ) continue;
+
+      while ( (pace->head != NULL) && ((time = AxisG2_PaceTime(pace)) <= now) ) {
+         AxisG2_PaceCharge(pace,pace->head,0);
+         AxisG2_PaceSend(hwData,pace->head);
+         pace->head = dmaQueuePopIrq(&(pace->q));
+      }
+
+      if ( pace->head != NULL ) {
+         if ( (next == 0) || (time < next) ) next = time;
+      }
+
+      // Release slot once pacing is disabled and nothing is waiting
+      else if ( (pace->frameRate == 0) && (pace->byteRate == 0) ) {
+         hwData->paceSlot[pace->dest] = 0;
+         pace->used = 0;
+         hwData->paceCount--;
+      }
+   }
+   if ( next != 0 ) AxisG2_PaceArm(hwData,next);
+
+   spin_unlock_irqrestore(&(hwData->paceLock),iflags);
+   return(HRTIMER_NORESTART);
+}
+
+// Set pacing for dest
+int32_t AxisG2_SetPace(struct AxisG2Data *hwData, struct AxisPace *cfg) {
+   struct AxisG2Pace * pace;
+   unsigned long iflags;
+   uint64_t now;
+   uint32_t slot;
+
+   if ( (cfg->dest >= DMA_MAX_DEST) || (hwData->paceSlot == NULL) ) return(-1);
+
+   spin_lock_irqsave(&(hwData->paceLock),iflags);
+
+   // Find free slot
+   if ( (slot = hwData->paceSlot[cfg->dest]) == 0 ) {
+      if ( (cfg->frameRate == 0) && (cfg->byteRate == 0) ) {
+         spin_unlock_irqrestore(&(hwData->paceLock),iflags);
+         return(0);
+      }
+      for (slot=0; (slot < AXIS2_PACE_MAX) && hwData->pace[slot].used; slot++);
+      if ( slot == AXIS2_PACE_MAX ) {
+         spin_unlock_irqrestore(&(hwData->paceLock),iflags);
+         return(-1);
+      }
+      pace = &(hwData->pace[slot]);
+      pace->used    = 1;
+      pace->dest    = cfg->dest;
+      pace->head    = NULL;
+      pace->frames  = 0;
+      pace->delayed = 0;
+      hwData->paceSlot[cfg->dest] = slot + 1;
+      hwData->paceCount++;
+   }
+   else pace = &(hwData->pace[slot-1]);
+
+   now = ktime_get_ns();
+   pace->frameRate = cfg->frameRate;
+   pace->frameNs   = (cfg->frameRate == 0) ? 0 : div_u64(1000000000ULL,cfg->frameRate);
+   pace->frameTau  = (uint64_t)cfg->frameBurst * pace->frameNs;
+   pace->frameNext = now;
+   pace->byteRate  = cfg->byteRate;
+   pace->byteTau   = (cfg->byteRate == 0) ? 0 : div64_u64((uint64_t)cfg->byteBurst * 1000000000ULL,cfg->byteRate);
+   pace->byteNext  = now;
+
+   // Let the timer release waiting frames at the new rate or free the slot
+   AxisG2_PaceArm(hwData,now);
+
+   spin_unlock_irqrestore(&(hwData->paceLock),iflags);
+   return(0);
+}
+
 // Execute command
 int32_t AxisG2_Command(struct DmaDevice *dev, uint32_t cmd, uint64_t arg) {
+   struct AxisPostBench bench;
+   struct AxisModeration mod;
+   struct AxisPace pace;
+   struct AxisG2Data * hwData;
    struct AxisG2Reg *reg;
+   uint32_t dest;
+   uint32_t cls;
+   int32_t ret;
+
    reg = (struct AxisG2Reg *)dev->reg;
+   hwData = (struct AxisG2Data *)dev->hwData;
 
    switch (cmd) {
 
       // Read ACK
       case AXIS_Read_Ack:
-         spin_lock(&dev->commandLock);
+         dmaSpinLock(&dev->commandLock,&dev->commandStats);
          iowrite32(0x1,&(reg->acknowledge));
          spin_unlock(&dev->commandLock);
          return(0);
          break;
 
+      // Set interrupt moderation
+      case AXIS_Set_Moderation:
+         if ((ret = copy_from_user(&mod,(void *)arg,sizeof(struct AxisModeration)))) {
+            dev_warn(dev->device,"Command: copy_from_user failed. ret=%i, user=%p kern=%p\n", ret, (void *)arg, &mod);
+            return(-1);
+         }
+         if ( (mod.holdoff > AXIS_MOD_MAX_HOLDOFF) ||
+              ((mod.holdoff == 0) && ((mod.minFrames != 0) || (mod.adaptive != 0))) ||
+              (mod.minFrames >= hwData->eng.addrCount) ) {
+            dev_warn(dev->device,"Command: Invalid moderation. holdoff=%u, minFrames=%u, adaptive=%u\n",
+                     mod.holdoff, mod.minFrames, mod.adaptive);
+            return(-EINVAL);
+         }
+
+         // Disable while updating, interrupt handler reads without lock
+         hwData->modHoldoff   = 0;
+         smp_wmb();
+         hwData->modMinFrames = mod.minFrames;
+         hwData->modAdaptive  = mod.adaptive;
+         smp_wmb();
+         hwData->modHoldoff   = mod.holdoff;
+         return(0);
+         break;
+
+      // Get interrupt moderation
+      case AXIS_Get_Moderation:
+         mod.minFrames = hwData->modMinFrames;
+         mod.holdoff   = hwData->modHoldoff;
+         mod.adaptive  = hwData->modAdaptive;
+         mod.rate      = hwData->modRate;
+         mod.deferred  = hwData->modDeferred;
+         mod.pad       = 0;
+         if ((ret = copy_to_user((void *)arg,&mod,sizeof(struct AxisModeration)))) {
+            dev_warn(dev->device,"Command: copy_to_user failed. ret=%i, user=%p kern=%p\n", ret, (void *)arg, &mod);
+            return(-1);
+         }
+         return(0);
+         break;
+
+      // Descriptor posting benchmark
+      case AXIS_Post_Bench:
+         if ((ret = copy_from_user(&bench,(void *)arg,sizeof(struct AxisPostBench)))) {
+            dev_warn(dev->device,"Command: copy_from_user failed. ret=%i, user=%p kern=%p\n", ret, (void *)arg, &bench);
+            return(-1);
+         }
+         if ( (ret = AxisG2_PostBench(dev,hwData,&bench)) < 0 ) return(ret);
+         if ((ret = copy_to_user((void *)arg,&bench,sizeof(struct AxisPostBench)))) {
+            dev_warn(dev->device,"Command: copy_to_user failed. ret=%i, user=%p kern=%p\n", ret, (void *)arg, &bench);
+            return(-1);
+         }
+         return(0);
+         break;
+
+      // Set transmit pacing for dest
+      case AXIS_Set_Pace:
+         if ((ret = copy_from_user(&pace,(void *)arg,sizeof(struct AxisPace)))) {
+            dev_warn(dev->device,"Command: copy_from_user failed. ret=%i, user=%p kern=%p\n", ret, (void *)arg, &pace);
+            return(-1);
+         }
+         if ( AxisG2_SetPace(hwData,&pace) < 0 ) {
+            dev_warn(dev->device,"Command: Failed to set pacing for dest=%i\n",pace.dest);
+            return(-1);
+         }
+         return(0);
+         break;
+
+      // Set transmit class, bits 31:24 = class, bit 16 = strict, bits 15:0 = weight
+      case AXIS_Set_TxClass:
+         cls = (arg >> 24) & 0xFF;
+         if ( cls >= AXIS_TX_CLASSES ) {
+            dev_warn(dev->device,"Command: Invalid tx class=%i\n",cls);
+            return(-1);
+         }
+         hwData->txStrict[cls] = (arg >> 16) & 0x1;
+         hwData->txWeight[cls] = ((arg & 0xFFFF) == 0) ? 1 : (arg & 0xFFFF);
+         return(0);
+         break;
+
+      // Set transmit class for dest, bits 23:16 = class, bits 15:0 = dest
+      case AXIS_Set_TxDest:
+         cls  = (arg >> 16) & 0xFF;
+         dest = arg & 0xFFFF;
+         if ( (cls >= AXIS_TX_CLASSES) || (dest >= DMA_MAX_DEST) || (hwData->txClass == NULL) ) {
+            dev_warn(dev->device,"Command: Invalid tx dest=%i, class=%i\n",dest,cls);
+            return(-1);
+         }
+         hwData->txClass[dest] = cls;
+         return(0);
+         break;
+
       default:
          dev_warn(dev->device,"Command: Invalid command=%i\n",cmd); 
          return(-1);
@@ -515,26 +1514,81 @@ int32_t AxisG2_Command(struct DmaDevice *dev, uint32_t cmd, uint64_t arg) {
 
 // Add data to proc dump
 void AxisG2_SeqShow(struct seq_file *s, struct DmaDevice *dev) {
-   struct AxisG2Reg *reg;
+   struct AxisG2TxClass * cls;
+   struct AxisG2Pace * pace;
+   struct AxisG2Engine * eng;
    struct AxisG2Data * hwData;
+   uint32_t x;
+   uint32_t c;
 
-   reg = (struct AxisG2Reg *)dev->reg;
    hwData = (struct AxisG2Data *)dev->hwData;
 
    seq_printf(s,"\n");
    seq_printf(s,"-------------- General HW -----------------\n");
-   seq_printf(s,"          Int Req Count : %u\n",(ioread32(&(reg->intReqCount))));
-   seq_printf(s,"        Hw Dma Wr Index : %u\n",(ioread32(&(reg->hwWrIndex))));
-   seq_printf(s,"        Sw Dma Wr Index : %u\n",hwData->writeIndex);
-   seq_printf(s,"        Hw Dma Rd Index : %u\n",(ioread32(&(reg->hwRdIndex))));
-   seq_printf(s,"        Sw Dma Rd Index : %u\n",hwData->readIndex);
-   seq_printf(s,"     Missed Wr Requests : %u\n",(ioread32(&(reg->wrReqMissed))));
    seq_printf(s,"       Missed IRQ Count : %u\n",hwData->missedIrq);
-   seq_printf(s,"         Continue Count : %u\n",hwData->contCount);
-   seq_printf(s,"          Address Count : %i\n",hwData->addrCount);
-   seq_printf(s,"    Hw Write Buff Count : %i\n",hwData->hwWrBuffCnt);
-   seq_printf(s,"     Hw Read Buff Count : %i\n",hwData->hwRdBuffCnt);
-   seq_printf(s,"           Cache Config : 0x%x\n",(ioread32(&(reg->cacheConfig))));
+   seq_printf(s,"         Hw Drop Enable : %u\n",(ioread32(&(hwData->eng.reg->dropEnable))));
    seq_printf(s,"            Desc 128 En : %i\n",hwData->desc128En);
-}
+   seq_printf(s,"             IRQ Budget : %u\n",dev->cfgIrqBudget);
+   seq_printf(s,"  Moderation Holdoff uS : %u\n",hwData->modHoldoff);
+   seq_printf(s,"  Moderation Min Frames : %u\n",hwData->modMinFrames);
+   seq_printf(s,"    Moderation Adaptive : %u\n",hwData->modAdaptive);
+   seq_printf(s,"  Observed Entry Rate/s : %u\n",hwData->modRate);
+   seq_printf(s,"     Deferred IRQ Count : %u\n",hwData->modDeferred);
+
+   if ( dev->cfgIrqBudget > 0 ) {
+      seq_printf(s,"          Threaded IRQs : %u\n",hwData->irqCount);
+      seq_printf(s,"             Poll Count : %u\n",hwData->pollCount);
+      seq_printf(s,"          Polls Per IRQ : %u\n",(hwData->irqCount == 0)?0:(hwData->pollCount/hwData->irqCount));
+      seq_printf(s,"          Work Per Poll : %llu\n",(hwData->pollCount == 0)?0:div_u64(hwData->workCount,hwData->pollCount));
+      seq_printf(s,"      Max Work Per Poll : %u\n",hwData->maxWork);
+   }
+   if ( hwData->desc128En ) {
+      for (c=0; c < AXIS_TX_CLASSES; c++)
+         seq_printf(s,"      Tx Class %u Config : %s, weight %u\n",c,hwData->txStrict[c]?"strict":"weighted",hwData->txWeight[c]);
+   }
+
+   for (x=0; x < AXIS2_PACE_MAX; x++) {
+      pace = &(hwData->pace[x]);
+      if ( pace->used )
+         seq_printf(s,"         Pace Dest %4u : %u fps, %llu Bps, frames %llu, delayed %llu, waiting %u\n",
+                    pace->dest,pace->frameRate,pace->byteRate,pace->frames,pace->delayed,
+                    dmaQueueCount(&(pace->q)) + ((pace->head == NULL)?0:1));
+   }
+
+   eng = &(hwData->eng);
 
+   seq_printf(s,"\n");
+   seq_printf(s,"-------------- Rings ----------------------\n");
+   seq_printf(s,"          Int Req Count : %u\n",(ioread32(&(eng->reg->intReqCount))));
+   seq_printf(s,"        Hw Dma Wr Index : %u\n",(ioread32(&(eng->reg->hwWrIndex))));
+   seq_printf(s,"        Sw Dma Wr Index : %u\n",eng->writeIndex);
+   seq_printf(s,"        Hw Dma Rd Index : %u\n",(ioread32(&(eng->reg->hwRdIndex))));
+   seq_printf(s,"        Sw Dma Rd Index : %u\n",eng->readIndex);
+   seq_printf(s,"     Missed Wr Requests : %u\n",(ioread32(&(eng->reg->wrReqMissed))));
+   seq_printf(s,"         Continue Count : %u\n",eng->contCount);
+   seq_printf(s,"          Address Count : %i\n",eng->addrCount);
+   seq_printf(s,"    Hw Write Buff Count : %i\n",eng->hwWrBuffCnt);
+   seq_printf(s,"     Hw Read Buff Count : %i\n",eng->hwRdBuffCnt);
+   seq_printf(s,"           Cache Config : 0x%x\n",(ioread32(&(eng->reg->cacheConfig))));
+   seq_printf(s,"        Wide Desc Posts : %i\n",eng->postWide);
+   seq_printf(s,"       Addr Table WC En : %i\n",eng->addrTableWc);
+   seq_printf(s,"         Rx Entry Count : %llu\n",eng->rxCount);
+   seq_printf(s,"         Tx Entry Count : %llu\n",eng->txCount);
+   if ( dev->cfgTxLazy > 0 ) 
+      seq_printf(s,"     Tx Lazy Reap Count : %llu\n",eng->txReaped);
+   if ( (eng->rdStats.count != 0) || (eng->wrStats.count != 0) ) {
+      seq_printf(s,"           Rd Ring Lock : Count %llu, Contended %llu, Wait %llu nS, Max %llu nS\n",
+                 eng->rdStats.count,eng->rdStats.contended,eng->rdStats.waitNs,eng->rdStats.maxNs);
+      seq_printf(s,"           Wr Ring Lock : Count %llu, Contended %llu, Wait %llu nS, Max %llu nS\n",
+                 eng->wrStats.count,eng->wrStats.contended,eng->wrStats.waitNs,eng->wrStats.maxNs);
+   }
+   if ( hwData->desc128En ) {
+      for (c=0; c < AXIS_TX_CLASSES; c++) {
+         cls = &(eng->txq[c]);
+         seq_printf(s,"       Tx Class %u Depth : %u, max %u\n",c,dmaQueueCount(&(cls->q)),cls->maxDepth);
+         seq_printf(s,"      Tx Class %u Frames : %llu\n",c,cls->frames);
+         seq_printf(s,"     Tx Class %u Wait uS : avg %llu, max %llu\n",c,
+                    (cls->frames == 0)?0:div_u64(div_u64(cls->waitNs,cls->frames),1000),div_u64(cls->maxWaitNs,1000));
+      }
+   }
+}
@@ -22,10 +22,27 @@
 
 #include <dma_common.h>
 #include <dma_buffer.h>
+#include <AxisDriver.h>
 #include <linux/interrupt.h>
+#include <linux/hrtimer.h>
 
 #define AXIS2_RING_ACP 0x10
 
+// Completion entries mapped and cleared per batch
+#define AXIS2_BATCH 32
+
+struct AxisPostBench;
+struct AxisPace;
+
+// Descriptor posting modes, cfgDescPost
+// WIDE posts register pairs with single 64-bit writes, firmware must accept 64-bit FIFO writes.
+// WC maps the address table write combined, flushed before each descriptor FIFO write.
+#define AXIS2_POST_WIDE 0x1
+#define AXIS2_POST_WC   0x2
+
+// Maximum number of paced dests
+#define AXIS2_PACE_MAX 16
+
 struct AxisG2Reg {
    uint32_t enableVer;       // 0x0000
    uint32_t intEnable;       // 0x0004
@@ -71,8 +88,44 @@ struct AxisG2Return {
    uint8_t  cont;
 };
 
-struct AxisG2Data {
-   uint32_t    desc128En;
+// Transmit class queue and stats
+struct AxisG2TxClass {
+   struct DmaQueue q;
+   uint32_t        maxDepth;
+   uint64_t        frames;
+   uint64_t        waitNs;
+   uint64_t        maxWaitNs;
+};
+
+// Transmit pacing slot, token buckets are kept as next release times
+struct AxisG2Pace {
+   uint32_t           used;
+   uint32_t           dest;
+   struct DmaBuffer * head;
+   struct DmaQueue    q;
+   uint32_t           frameRate;
+   uint64_t           frameNs;
+   uint64_t           frameTau;
+   uint64_t           frameNext;
+   uint64_t           byteRate;
+   uint64_t           byteTau;
+   uint64_t           byteNext;
+   uint64_t           frames;
+   uint64_t           delayed;
+};
+
+// Engine rings and queues
+struct AxisG2Engine {
+   struct AxisG2Reg * reg;
+
+   // Ring locks, read (transmit) ring and write (receive free) ring.
+   // Protect FIFO writes, hw buffer counts and software queue order.
+   spinlock_t  rdLock;
+   spinlock_t  wrLock;
+
+   // Ring lock contention
+   struct DmaLockStats rdStats;
+   struct DmaLockStats wrStats;
 
    uint32_t  * readAddr;
    dma_addr_t  readHandle;
@@ -83,29 +136,148 @@ struct AxisG2Data {
    uint32_t    writeIndex;
 
    uint32_t    addrCount;
-   uint32_t    missedIrq;
+
+   // Descriptor posting, address table may be write combined
+   uint32_t    postWide;
+   uint32_t  * addrTable;
+   uint32_t    addrTableWc;
 
    uint32_t    hwWrBuffCnt;
    uint32_t    hwRdBuffCnt;
 
    struct DmaQueue wrQueue;
-   struct DmaQueue rdQueue;
+
+   // Transmit class queues, protected by rdLock
+   struct AxisG2TxClass txq[AXIS_TX_CLASSES];
+   uint32_t             txQueued;
+   uint32_t             txRr;
+   uint32_t             txCredit;
 
    uint32_t    contCount;
+   uint32_t    ackCount;
+   uint64_t    rxCount;
+   uint64_t    txCount;
+
+   // Lazy transmit reclaim, read ring index acked so far
+   uint32_t    txAckIndex;
+   uint64_t    txReaped;
+};
+
+struct AxisG2Data {
+   struct DmaDevice * dev;
+
+   uint32_t    desc128En;
+   uint32_t    missedIrq;
+
+   // Handlers specialized for descriptor format, installed at init
+   struct hardware_functions   hwFunc;
+   struct hardware_functions * baseFunc;
+   uint32_t (*procEngine)(struct DmaDevice *dev, struct AxisG2Data *hwData, struct AxisG2Engine *eng, uint32_t budget);
+   uint32_t (*procEngineDebug)(struct DmaDevice *dev, struct AxisG2Data *hwData, struct AxisG2Engine *eng, uint32_t budget);
+   uint32_t (*txReapEngine)(struct DmaDevice *dev, struct AxisG2Data *hwData, struct AxisG2Engine *eng);
+
+   // Engine rings, firmware does not report additional engine register blocks
+   struct AxisG2Engine eng;
+
+   // Transmit class config, class per dest
+   uint8_t  * txClass;
+   uint32_t   txStrict[AXIS_TX_CLASSES];
+   uint32_t   txWeight[AXIS_TX_CLASSES];
+
+   // Transmit pacing, slot + 1 per dest, zero when not paced
+   spinlock_t        paceLock;
+   struct hrtimer    paceTimer;
+   uint8_t         * paceSlot;
+   uint32_t          paceCount;
+   struct AxisG2Pace pace[AXIS2_PACE_MAX];
+
+   // Completions and free list refills of the interrupt being serviced
+   uint32_t    irqRx;
+   uint32_t    irqTx;
+   uint32_t    irqRefill;
+
+   // Threaded processing stats
+   uint32_t    irqCount;
+   uint32_t    pollCount;
+   uint64_t    workCount;
+   uint32_t    maxWork;
+
+   // Interrupt moderation, holdoff is emulated with timer
+   // modLock serializes service between the handler and the timer
+   struct hrtimer modTimer;
+   spinlock_t     modLock;
+   uint32_t       modMinFrames;
+   uint32_t       modHoldoff;
+   uint32_t       modAdaptive;
+   uint32_t       modRate;
+   uint32_t       modRateFrames;
+   unsigned long  modRateTime;
+   uint32_t       modDeferred;
 };
 
 // Map return
-inline uint8_t AxisG2_MapReturn ( struct DmaDevice *dev, struct AxisG2Return *ret, uint32_t desc128En, uint32_t index, uint32_t *ring);
+inline uint8_t AxisG2_MapReturn ( struct AxisG2Return *ret, uint32_t desc128En, uint32_t index, uint32_t *ring);
+
+// Map a batch of completions up to hardware index, consumed entries are cleared in bulk
+uint32_t AxisG2_MapBatch ( struct AxisG2Return *ret, uint32_t desc128En, uint32_t *ring, uint32_t addrCount,
+                           uint32_t *index, uint32_t hwIndex, uint32_t max );
 
 // Add buffer to free list
-inline void AxisG2_WriteFree ( struct DmaBuffer *buff, struct AxisG2Reg *reg, uint32_t desc128En );
+inline void AxisG2_WriteFree ( struct DmaBuffer *buff, struct AxisG2Engine *eng, uint32_t desc128En );
 
 // Add buffer to tx list
-inline void AxisG2_WriteTx ( struct DmaBuffer *buff, struct AxisG2Reg *reg, uint32_t desc128En );
+inline void AxisG2_WriteTx ( struct DmaBuffer *buff, struct AxisG2Engine *eng, uint32_t desc128En );
+
+// Post receive buffers to engine free list, remainder is queued when ring is full
+uint32_t AxisG2_PostFree(struct AxisG2Data *hwData, struct AxisG2Engine *eng, struct DmaBuffer **buff, uint32_t count);
+
+// Queue transmit buffer on its dest class, called with read ring lock held
+void AxisG2_TxQueue(struct AxisG2Data *hwData, struct AxisG2Engine *eng, struct DmaBuffer *buff);
+
+// Feed read ring from transmit class queues, called with read ring lock held
+void AxisG2_TxFeed(struct AxisG2Data *hwData, struct AxisG2Engine *eng);
+
+// Post transmit buffers to engine, remainder is queued when ring is full
+uint32_t AxisG2_PostTx(struct AxisG2Data *hwData, struct AxisG2Engine *eng, struct DmaBuffer **buff, uint32_t count);
+
+// Process TX and RX rings of a single engine, each ring is limited to budget entries
+// Specialized for 64-bit and 128-bit descriptors, with and without debug messages
+uint32_t AxisG2_ProcessEngine64(struct DmaDevice *dev, struct AxisG2Data *hwData, struct AxisG2Engine *eng, uint32_t budget);
+uint32_t AxisG2_ProcessEngine128(struct DmaDevice *dev, struct AxisG2Data *hwData, struct AxisG2Engine *eng, uint32_t budget);
+uint32_t AxisG2_ProcessEngine64Debug(struct DmaDevice *dev, struct AxisG2Data *hwData, struct AxisG2Engine *eng, uint32_t budget);
+uint32_t AxisG2_ProcessEngine128Debug(struct DmaDevice *dev, struct AxisG2Data *hwData, struct AxisG2Engine *eng, uint32_t budget);
+
+// Process context transmit reclaim of a single engine
+uint32_t AxisG2_TxReapEngine64(struct DmaDevice *dev, struct AxisG2Data *hwData, struct AxisG2Engine *eng);
+uint32_t AxisG2_TxReapEngine128(struct DmaDevice *dev, struct AxisG2Data *hwData, struct AxisG2Engine *eng);
+
+// Reclaim transmit completions from process context, lazy reclaim mode
+void AxisG2_TxReap(struct DmaDevice *dev);
+
+// Process all engines
+uint32_t AxisG2_Process(struct DmaDevice *dev, struct AxisG2Data *hwData, uint32_t budget);
+
+// Enable interrupt on all engines and update ack counts
+void AxisG2_Ack(struct AxisG2Data *hwData);
+
+// Count ready receive entries over all engines, up to max
+uint32_t AxisG2_RxReady(struct AxisG2Data *hwData, uint32_t max);
+
+// Determine if interrupt service should be held off
+uint32_t AxisG2_Moderate(struct DmaDevice *dev, struct AxisG2Data *hwData);
+
+// Service rings or defer to irq thread, interrupt must be disabled
+irqreturn_t AxisG2_Service(struct DmaDevice *dev, struct AxisG2Data *hwData);
+
+// Moderation holdoff timer
+enum hrtimer_restart AxisG2_ModTimer(struct hrtimer *timer);
 
 // Interrupt handler
 irqreturn_t AxisG2_Irq(int irq, void *dev_id);
 
+// Threaded interrupt handler
+irqreturn_t AxisG2_IrqThread(int irq, void *dev_id);
+
 // Init card in top level Probe
 void AxisG2_Init(struct DmaDevice *dev);
 
@@ -117,9 +289,28 @@ void AxisG2_Clear(struct DmaDevice *dev);
 
 // Return receive buffers to card
 void AxisG2_RetRxBuffer(struct DmaDevice *dev, struct DmaBuffer **buff, uint32_t count);
+void AxisG2_RetRxBuffer64(struct DmaDevice *dev, struct DmaBuffer **buff, uint32_t count);
+void AxisG2_RetRxBuffer128(struct DmaDevice *dev, struct DmaBuffer **buff, uint32_t count);
 
 // Send a buffer
 int32_t AxisG2_SendBuffer(struct DmaDevice *dev, struct DmaBuffer **buff, uint32_t count);
+int32_t AxisG2_SendBuffer64(struct DmaDevice *dev, struct DmaBuffer **buff, uint32_t count);
+int32_t AxisG2_SendBuffer128(struct DmaDevice *dev, struct DmaBuffer **buff, uint32_t count);
+
+// Post a single transmit buffer outside of pacing
+void AxisG2_PaceSend(struct AxisG2Data *hwData, struct DmaBuffer *buff);
+
+// Pace transmit buffer, returns 1 if buffer was taken by pacing
+uint32_t AxisG2_Pace(struct AxisG2Data *hwData, struct DmaBuffer *buff);
+
+// Pacing release timer
+enum hrtimer_restart AxisG2_PaceTimer(struct hrtimer *timer);
+
+// Set pacing for dest
+int32_t AxisG2_SetPace(struct AxisG2Data *hwData, struct AxisPace *cfg);
+
+// Descriptor posting benchmark
+int32_t AxisG2_PostBench(struct DmaDevice *dev, struct AxisG2Data *hwData, struct AxisPostBench *bench);
 
 // Execute command
 int32_t AxisG2_Command(struct DmaDevice *dev, uint32_t cmd, uint64_t arg);
@@ -25,7 +25,9 @@
 #include <linux/sort.h>
 #include <linux/sched.h>
 #include <linux/slab.h>
+#include <linux/jiffies.h>
 #include <dma_common.h>
+#include <dma_trace.h>
 
 // Create a list of buffer
 // Return number of buffers created
@@ -282,6 +284,8 @@ struct DmaBuffer * dmaRetBufferIrq ( struct DmaDevice *dev, dma_addr_t handle )
 
    // Return buffer to transmit queue if it is found
    if ( (buff = dmaFindBufferList (&(dev->txBuffers),handle)) != NULL) {
+      trace_dma_tx_done(buff);
+      dmaDestTx(dev,buff);
       dmaBufferFromHw(buff);
       dmaQueuePushIrq(&(dev->tq),buff);
       return(NULL);
@@ -289,6 +293,8 @@ struct DmaBuffer * dmaRetBufferIrq ( struct DmaDevice *dev, dma_addr_t handle )
 
    // Return rx buffer
    else if ( (buff = dmaFindBufferList (&(dev->rxBuffers),handle)) != NULL) {
+      trace_dma_tx_done(buff);
+      dmaDestTx(dev,buff);
       return(buff);
    }
 
@@ -306,6 +312,8 @@ struct DmaBuffer * dmaRetBufferIdx ( struct DmaDevice *dev, uint32_t index ) {
 
    // Return buffer to transmit queue if it is found
    if ( (buff = dmaGetBufferList (&(dev->txBuffers),index)) != NULL) {
+      trace_dma_tx_done(buff);
+      dmaDestTx(dev,buff);
       dmaBufferFromHw(buff);
       dmaQueuePush(&(dev->tq),buff);
       return(NULL);
@@ -313,6 +321,8 @@ struct DmaBuffer * dmaRetBufferIdx ( struct DmaDevice *dev, uint32_t index ) {
 
    // Return rx buffer
    else if ( (buff = dmaGetBufferList (&(dev->rxBuffers),index)) != NULL) {
+      trace_dma_tx_done(buff);
+      dmaDestTx(dev,buff);
       return(buff);
    }
 
@@ -330,6 +340,8 @@ struct DmaBuffer * dmaRetBufferIdxIrq ( struct DmaDevice *dev, uint32_t index )
 
    // Return buffer to transmit queue if it is found
    if ( (buff = dmaGetBufferList (&(dev->txBuffers),index)) != NULL) {
+      trace_dma_tx_done(buff);
+      dmaDestTx(dev,buff);
       dmaBufferFromHw(buff);
       dmaQueuePushIrq(&(dev->tq),buff);
       return(NULL);
@@ -337,6 +349,8 @@ struct DmaBuffer * dmaRetBufferIdxIrq ( struct DmaDevice *dev, uint32_t index )
 
    // Return rx buffer
    else if ( (buff = dmaGetBufferList (&(dev->rxBuffers),index)) != NULL) {
+      trace_dma_tx_done(buff);
+      dmaDestTx(dev,buff);
       return(buff);
    }
 
@@ -347,19 +361,165 @@ struct DmaBuffer * dmaRetBufferIdxIrq ( struct DmaDevice *dev, uint32_t index )
    }
 }
 
-// Push buffer to descriptor receive queue
-void dmaRxBuffer ( struct DmaDesc *desc, struct DmaBuffer *buff ) {
+// Push buffer to descriptor receive queue, applying the descriptor overflow mode
+// Returns a buffer which must be returned to the hardware free list, NULL if none
+// Called inside IRQ routine
+struct DmaBuffer * dmaRxBufferIrq ( struct DmaDesc *desc, struct DmaBuffer *buff ) {
+   struct DmaBuffer * drop;
+
    dmaBufferFromHw(buff);
-   dmaQueuePush(&(desc->q),buff);
-   if (desc->async_queue) kill_fasync(&desc->async_queue, SIGIO, POLL_IN);
+   drop = NULL;
+
+   // Queue is at configured depth
+   if ( (desc->ovfMode != DMA_OVF_BLOCK) && (desc->ovfDepth != 0) && (dmaQueueCount(&(desc->q)) >= desc->ovfDepth) ) {
+      if ( desc->ovfMode == DMA_OVF_DROP_OLD ) drop = dmaQueuePopIrq(&(desc->q));
+      else drop = buff;
+   }
+
+   // Buffer overflow returns the new frame
+   if ( (drop != buff) && dmaQueuePushIrq(&(desc->q),buff) ) drop = buff;
+
+   // Frame was queued
+   if ( drop != buff ) {
+      trace_dma_rx_queue(buff);
+      if ( desc->async_queue ) kill_fasync(&desc->async_queue, SIGIO, POLL_IN);
+   }
+
+   // Track drops
+   if ( drop != NULL ) {
+      desc->dropCount++;
+      if ( drop->dest < DMA_MAX_DEST ) {
+         desc->dev->destStats[drop->dest].ovfDrops++;
+         desc->dev->destStats[drop->dest].dropBytes += drop->size;
+      }
+   }
+   return(drop);
 }
 
-// Push buffer to descriptor receive queue
-// Called inside IRQ routine
-void dmaRxBufferIrq ( struct DmaDesc *desc, struct DmaBuffer *buff ) {
-   dmaBufferFromHw(buff);
-   dmaQueuePushIrq(&(desc->q),buff);
-   if (desc->async_queue) kill_fasync(&desc->async_queue, SIGIO, POLL_IN);
+// Check received buffer against descriptor filter
+// Return 1 if buffer should be delivered, must be called with maskLock held
+uint32_t dmaRxFilter ( struct DmaDesc *desc, struct DmaBuffer *buff ) {
+   struct DmaFilterRule * rule;
+   uint32_t x;
+
+   for (x=0; x < desc->filterCount; x++) {
+      rule = &(desc->filter[x]);
+
+      if ( (buff->dest < rule->destMin) || (buff->dest > rule->destMax) ||
+           (buff->size < rule->sizeMin) || (buff->size > rule->sizeMax) ||
+           ((buff->flags & rule->flagsMask) != rule->flagsValue) ||
+           ((buff->error & rule->errorMask) != rule->errorValue) ) continue;
+
+      rule->hits++;
+
+      if ( rule->action == DMA_FILT_DROP ) return(0);
+      if ( rule->action == DMA_FILT_DELIVER ) return(1);
+   }
+   return(1);
+}
+
+// Count a received buffer that has no reader, buffer is returned to hardware by caller
+// Must be called with maskLock held, inside IRQ routine
+void dmaRxIdleIrq ( struct DmaDevice *dev, struct DmaBuffer *buff ) {
+   trace_dma_rx_done(buff);
+   dmaDestRx(dev,buff);
+
+   if ( buff->dest < DMA_MAX_DEST ) {
+      dev->destStats[buff->dest].idleDrops++;
+      dev->destStats[buff->dest].dropBytes += buff->size;
+   }
+}
+
+// Deliver a received buffer to the destination owner and to secondary descriptors
+// Must be called with maskLock held, inside IRQ routine
+// Returns a buffer which must be returned to the hardware free list, NULL if none
+struct DmaBuffer * dmaRxDeliverIrq ( struct DmaDevice *dev, struct DmaBuffer *buff ) {
+   struct DmaDesc   * desc;
+   struct DmaBuffer * drop;
+   struct DmaBuffer * ret;
+   uint32_t x;
+
+   if ( buff->dest < DMA_MAX_DEST ) desc = dev->desc[buff->dest];
+   else desc = NULL;
+
+   // Nobody is listening
+   if ( desc == NULL && dev->secCount == 0 ) {
+      dmaRxIdleIrq(dev,buff);
+      return(buff);
+   }
+
+   trace_dma_rx_done(buff);
+   dmaDestRx(dev,buff);
+   buff->qTime  = ktime_get_ns();
+   buff->rdTime = 0;
+
+   // Hold a delivery reference while passing to readers
+   atomic_set(&(buff->refCnt),1);
+   ret = NULL;
+
+   // Primary owner, filtered frames are not queued
+   if ( (desc != NULL) && dmaRxFilter(desc,buff) ) {
+      atomic_inc(&(buff->refCnt));
+      if ( ((drop = dmaRxBufferIrq(desc,buff)) != NULL) && (drop != buff) && dmaBufferRelease(drop) ) ret = drop;
+      else if ( drop == buff ) dmaBufferRelease(buff);
+   }
+
+   // Secondary readers, skipped when they hold too many buffers
+   if ( (dev->secCount != 0) && (buff->dest < DMA_MAX_DEST) ) {
+      for (x=0; x < DMA_MAX_SECONDARY; x++) {
+         if ( ((desc = dev->secDesc[x]) == NULL) || ((desc->destMask[buff->dest / 8] & (1 << (buff->dest % 8))) == 0) ) continue;
+
+         // Filtered frames do not count against sampling
+         if ( ! dmaRxFilter(desc,buff) ) continue;
+
+         // Prescaled tap, pass one in secPrescale frames
+         if ( desc->secPrescale > 1 ) {
+            if ( ++desc->secPreCount < desc->secPrescale ) continue;
+            desc->secPreCount = 0;
+         }
+
+         // Rate limited tap, pass at most secRate frames per second
+         if ( desc->secRate != 0 ) {
+            if ( time_after_eq(jiffies,desc->secRateTime + HZ) ) {
+               desc->secRateTime  = jiffies;
+               desc->secRateCount = 0;
+            }
+            if ( desc->secRateCount >= desc->secRate ) continue;
+            desc->secRateCount++;
+         }
+
+         if ( atomic_read(&(desc->secHeld)) >= desc->secMax ) {
+            desc->dropCount++;
+            continue;
+         }
+         if ( buff->inHw ) dmaBufferFromHw(buff);
+
+         atomic_inc(&(buff->refCnt));
+         atomic_inc(&(desc->secHeld));
+         set_bit(desc->secIdx,&(buff->secHas));
+
+         if ( dmaQueuePushIrq(&(desc->q),buff) ) {
+            clear_bit(desc->secIdx,&(buff->secHas));
+            atomic_dec(&(desc->secHeld));
+            atomic_dec(&(buff->refCnt));
+            desc->dropCount++;
+         }
+         else if (desc->async_queue) kill_fasync(&desc->async_queue, SIGIO, POLL_IN);
+      }
+   }
+
+   // Release delivery reference
+   if ( dmaBufferRelease(buff) ) ret = buff;
+
+   // Returned buffer was passed to software
+   if ( (ret != NULL) && (ret->inHw == 0) ) dmaBufferToHw(ret);
+   return(ret);
+}
+
+// Release a holder reference to a receive buffer
+// Return 1 if the buffer has no more holders and must be returned to hardware
+uint32_t dmaBufferRelease ( struct DmaBuffer *buff ) {
+   return(atomic_dec_and_test(&(buff->refCnt)) ? 1 : 0);
 }
 
 // Sort a buffer list
@@ -371,6 +531,7 @@ void dmaSortBuffers ( struct DmaBufferList *list ) {
 // Buffer being passed to hardware
 // Return -1 on error
 int32_t dmaBufferToHw ( struct DmaBuffer *buff) {
+   trace_dma_post_hw(buff);
 
    // Buffer is stream mode, sync
    if ( buff->buffList->dev->cfgMode & BUFF_STREAM ) {
@@ -413,6 +574,7 @@ size_t dmaQueueInit ( struct DmaQueue *queue, uint32_t count ) {
       queue->queue[x] = (struct DmaBuffer **)kmalloc(BUFFERS_PER_LIST * sizeof(struct DmaBuffer *),GFP_KERNEL);
 
    spin_lock_init(&(queue->lock));
+   memset(&(queue->lockStats),0,sizeof(struct DmaLockStats));
    init_waitqueue_head(&(queue->wait));
    return(count);
 }
@@ -435,6 +597,11 @@ uint32_t dmaQueueNotEmpty ( struct DmaQueue *queue ) {
    else return(1);
 }
 
+// Number of entries in queue
+uint32_t dmaQueueCount ( struct DmaQueue *queue ) {
+   return((queue->write + queue->count - queue->read) % queue->count);
+}
+
 // Push a queue entry
 // Use this routine outside of interrupt handler
 // Return 1 if fail, 0 if success
@@ -443,7 +610,7 @@ uint32_t dmaQueuePush  ( struct DmaQueue *queue, struct DmaBuffer *entry ) {
    uint32_t      next;
    uint32_t      ret;
 
-   spin_lock_irqsave(&(queue->lock),iflags);
+   dmaSpinLockIrqSave(&(queue->lock),&(queue->lockStats),iflags);
 
    next = (queue->write+1) % (queue->count);
    ret = 0;
@@ -469,7 +636,7 @@ uint32_t dmaQueuePushIrq ( struct DmaQueue *queue, struct DmaBuffer *entry ) {
    uint32_t      next;
    uint32_t      ret;
 
-   spin_lock(&(queue->lock));
+   dmaSpinLock(&(queue->lock),&(queue->lockStats));
 
    next = (queue->write+1) % (queue->count);
    ret = 0;
@@ -496,7 +663,7 @@ uint32_t dmaQueuePushList  ( struct DmaQueue *queue, struct DmaBuffer **buff, si
    uint32_t      ret;
    size_t        x;
 
-   spin_lock_irqsave(&(queue->lock),iflags);
+   dmaSpinLockIrqSave(&(queue->lock),&(queue->lockStats),iflags);
    ret = 0;
 
    for (x=0; x < cnt; x++) {
@@ -530,7 +697,7 @@ uint32_t dmaQueuePushListIrq ( struct DmaQueue *queue, struct DmaBuffer **buff,
    uint32_t      ret;
    size_t        x;
 
-   spin_lock(&(queue->lock));
+   dmaSpinLock(&(queue->lock),&(queue->lockStats));
    ret = 0;
 
    for (x=0; x < cnt; x++) {
@@ -562,7 +729,7 @@ struct DmaBuffer * dmaQueuePop  ( struct DmaQueue *queue ) {
    unsigned long      iflags;
    struct DmaBuffer * ret;
 
-   spin_lock_irqsave(&(queue->lock),iflags);
+   dmaSpinLockIrqSave(&(queue->lock),&(queue->lockStats),iflags);
 
    if ( queue->read == queue->write ) ret = NULL;
    else {
@@ -585,7 +752,7 @@ struct DmaBuffer * dmaQueuePop  ( struct DmaQueue *queue ) {
 struct DmaBuffer * dmaQueuePopIrq ( struct DmaQueue *queue ) {
    struct DmaBuffer * ret;
 
-   spin_lock(&(queue->lock));
+   dmaSpinLock(&(queue->lock),&(queue->lockStats));
 
    if ( queue->read == queue->write ) ret = NULL;
    else {
@@ -608,7 +775,7 @@ ssize_t dmaQueuePopList ( struct DmaQueue *queue, struct DmaBuffer**buff, size_t
    ssize_t ret;
 
    ret = 0;
-   spin_lock_irqsave(&(queue->lock),iflags);
+   dmaSpinLockIrqSave(&(queue->lock),&(queue->lockStats),iflags);
 
    while ( (ret < cnt) && (queue->read != queue->write) ) {
       buff[ret] = queue->queue[queue->read / BUFFERS_PER_LIST][queue->read % BUFFERS_PER_LIST];
@@ -631,7 +798,7 @@ ssize_t dmaQueuePopListIrq ( struct DmaQueue *queue, struct DmaBuffer**buff, siz
    ssize_t ret;
 
    ret = 0;
-   spin_lock(&(queue->lock));
+   dmaSpinLock(&(queue->lock),&(queue->lockStats));
 
    while ( (ret < cnt) && (queue->read != queue->write) ) {
       buff[ret] = queue->queue[queue->read / BUFFERS_PER_LIST][queue->read % BUFFERS_PER_LIST];
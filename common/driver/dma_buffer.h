@@ -26,6 +26,11 @@
 #include <linux/wait.h>
 #include <linux/types.h>
 #include <linux/dma-mapping.h>
+#include <linux/atomic.h>
+#include <linux/spinlock.h>
+#include <linux/version.h>
+#include <linux/jump_label.h>
+#include <linux/ktime.h>
 
 // Buffer modes
 // Primary modes are bits to enable app specific expansion
@@ -52,6 +57,15 @@ struct DmaBuffer {
    uint8_t          inQ;
    uint8_t          owner;
 
+   // Time buffer was placed in a software queue and read by index, nS
+   uint64_t         qTime;
+   uint64_t         rdTime;
+
+   // Receive holders, primary and secondary descriptors
+   // secHas holds one bit per secondary descriptor slot
+   atomic_t         refCnt;
+   unsigned long    secHas;
+
    // Associated data
    uint16_t    dest;
    uint32_t    flags;
@@ -90,6 +104,51 @@ struct DmaBufferList {
    uint32_t count;
 };
 
+// Lock contention statistics, updated while holding the lock they describe
+struct DmaLockStats {
+   uint64_t count;
+   uint64_t contended;
+   uint64_t waitNs;
+   uint64_t maxNs;
+};
+
+// Lock statistics are recorded while the static key is enabled by any device
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,3,0)
+DECLARE_STATIC_KEY_FALSE(DmaLockKey);
+#define dmaLockStatsOn() static_branch_unlikely(&DmaLockKey)
+#else
+extern struct static_key DmaLockKey;
+#define dmaLockStatsOn() static_key_false(&DmaLockKey)
+#endif
+
+// Take spinlock, counting acquisitions and time spent waiting when contended
+static inline void dmaSpinLock(spinlock_t *lock, struct DmaLockStats *st) {
+   uint64_t start;
+   uint64_t wait;
+
+   if ( ! dmaLockStatsOn() ) {
+      spin_lock(lock);
+      return;
+   }
+
+   if ( spin_trylock(lock) ) {
+      st->count++;
+      return;
+   }
+
+   start = ktime_get_ns();
+   spin_lock(lock);
+   wait = ktime_get_ns() - start;
+
+   st->count++;
+   st->contended++;
+   st->waitNs += wait;
+   if ( wait > st->maxNs ) st->maxNs = wait;
+}
+
+// Take spinlock with interrupts disabled, counting contention
+#define dmaSpinLockIrqSave(lock,st,flags) do { local_irq_save(flags); dmaSpinLock(lock,st); } while (0)
+
 // DMA Queue
 struct DmaQueue {
    uint32_t count;
@@ -103,7 +162,8 @@ struct DmaQueue {
    uint32_t write;
 
    // Access lock
-   spinlock_t lock;
+   spinlock_t          lock;
+   struct DmaLockStats lockStats;
 
    // Queue wait
    wait_queue_head_t wait;
@@ -153,12 +213,27 @@ struct DmaBuffer * dmaRetBufferIdx ( struct DmaDevice *device, uint32_t index );
 // transmit list return a pointer to the buffer. Passed value is the dma handle.
 struct DmaBuffer * dmaRetBufferIdxIrq ( struct DmaDevice *device, uint32_t index );
 
-// Push buffer to descriptor receive queue
-void dmaRxBuffer ( struct DmaDesc *desc, struct DmaBuffer *buff );
-
-// Push buffer to descriptor receive queue
+// Push buffer to descriptor receive queue, applying the descriptor overflow mode
+// Returns a buffer which must be returned to the hardware free list, NULL if none
 // Called inside IRQ routine
-void dmaRxBufferIrq ( struct DmaDesc *desc, struct DmaBuffer *buff );
+struct DmaBuffer * dmaRxBufferIrq ( struct DmaDesc *desc, struct DmaBuffer *buff );
+
+// Check received buffer against descriptor filter
+// Return 1 if buffer should be delivered, must be called with maskLock held
+uint32_t dmaRxFilter ( struct DmaDesc *desc, struct DmaBuffer *buff );
+
+// Count a received buffer that has no reader, buffer is returned to hardware by caller
+// Must be called with maskLock held, inside IRQ routine
+void dmaRxIdleIrq ( struct DmaDevice *dev, struct DmaBuffer *buff );
+
+// Deliver a received buffer to the destination owner and to secondary descriptors
+// Must be called with maskLock held, inside IRQ routine
+// Returns a buffer which must be returned to the hardware free list, NULL if none
+struct DmaBuffer * dmaRxDeliverIrq ( struct DmaDevice *dev, struct DmaBuffer *buff );
+
+// Release a holder reference to a receive buffer
+// Return 1 if the buffer has no more holders and must be returned to hardware
+uint32_t dmaBufferRelease ( struct DmaBuffer *buff );
 
 // Sort a buffer list
 void dmaSortBuffers ( struct DmaBufferList *list );
@@ -180,6 +255,9 @@ void dmaQueueFree ( struct DmaQueue *queue );
 // Return 0 if empty, 1 if not empty
 uint32_t dmaQueueNotEmpty ( struct DmaQueue *queue );
 
+// Number of entries in queue
+uint32_t dmaQueueCount ( struct DmaQueue *queue );
+
 // Push a queue entry
 // Return 1 if fail, 0 if success
 // Use IRQ method inside of IRQ handler
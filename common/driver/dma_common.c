@@ -22,12 +22,22 @@
 #include <DmaDriver.h>
 #include <dma_common.h>
 #include <dma_buffer.h>
+#include <dma_reg.h>
 #include <linux/proc_fs.h>
 #include <linux/seq_file.h>
 #include <linux/interrupt.h>
 #include <linux/sched.h>
 #include <linux/version.h>
 #include <linux/slab.h>
+#include <linux/delay.h>
+#include <linux/jiffies.h>
+#include <linux/debugfs.h>
+#include <linux/vmalloc.h>
+#include <linux/ktime.h>
+
+// Tracepoints are created here, other files only include the header
+#define CREATE_TRACE_POINTS
+#include <dma_trace.h>
 
 // Define interface routines
 struct file_operations DmaFunctions = {
@@ -51,6 +61,15 @@ static struct file_operations DmaProcOps = {
    .release = seq_release
 };
 
+// Setup debugfs trace file operations
+static struct file_operations DmaTraceOps = {
+   .owner   = THIS_MODULE,
+   .open    = Dma_TraceOpen,
+   .read    = seq_read,
+   .llseek  = seq_lseek,
+   .release = single_release
+};
+
 // Sequence operations
 static struct seq_operations DmaSeqOps = {
    .start = Dma_SeqStart,
@@ -62,6 +81,23 @@ static struct seq_operations DmaSeqOps = {
 // Number of active devices
 uint32_t gDmaDevCount;
 
+// Per frame debug enable
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,3,0)
+DEFINE_STATIC_KEY_FALSE(DmaDebugKey);
+#else
+struct static_key DmaDebugKey = STATIC_KEY_INIT_FALSE;
+#endif
+
+// Lock contention statistics enable
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,3,0)
+DEFINE_STATIC_KEY_FALSE(DmaLockKey);
+#else
+struct static_key DmaLockKey = STATIC_KEY_INIT_FALSE;
+#endif
+
+// Trace event names
+static const char * DmaTraceNames[] = { "none", "irq", "rx", "rx_ret", "tx", "read", "write", "index" };
+
 // Global variable for the device class 
 struct class * gCl;
 
@@ -102,6 +138,9 @@ int Dma_Init(struct DmaDevice *dev) {
 
    // Default debug disable
    dev->debug = 0;
+   dev->traceSample = 1;
+   atomic_set(&(dev->traceHead),0);
+   atomic_set(&(dev->traceCount),0);
 
    // Allocate device numbers for character device. 1 minor numer starting at 0
    res = alloc_chrdev_region(&(dev->devNum), 0, 1, dev->devName);
@@ -136,19 +175,55 @@ int Dma_Init(struct DmaDevice *dev) {
       return -1;
    }                                  
 
+   // Destination counters, page aligned and zeroed for mapping to user space
+   BUILD_BUG_ON(DMA_STATS_COUNT != DMA_MAX_DEST);
+   if ( (dev->destStats = vmalloc_user(DMA_MAX_DEST * sizeof(struct DmaDestStats))) == NULL ) {
+      dev_err(dev->device,"Init: Failed to allocate destination counters.\n");
+      return(-1);
+   }
+   for (x=0; x < DMA_MAX_DEST; x++) dev->destStats[x].dest = x;
+
+   // Throughput time series, sampling starts once buffers exist
+   if ( dev->cfgSample == 0 ) dev->cfgSample = DMA_SAMPLE_DEF;
+   if ( (dev->series = vzalloc(DMA_SERIES_SIZE * sizeof(struct DmaSample))) == NULL ) {
+      dev_err(dev->device,"Init: Failed to allocate throughput series.\n");
+      return(-1);
+   }
+   memset(&(dev->seriesTot),0,sizeof(struct DmaSample));
+   dev->seriesSeq = 0;
+   mutex_init(&(dev->seriesLock));
+   INIT_DELAYED_WORK(&(dev->seriesWork),Dma_SeriesWork);
+
    // Setup /proc
    proc_create_data(dev->devName, 0, NULL, &DmaProcOps, dev);
 
+   // Setup debugfs trace, debug still works through the proc dump without it
+   if ( (dev->trace = vzalloc(DMA_TRACE_SIZE * sizeof(struct DmaTraceEntry))) == NULL )
+      dev_warn(dev->device,"Init: Failed to allocate trace buffer.\n");
+   dev->traceDir = debugfs_create_dir(dev->devName, NULL);
+   if ( IS_ERR_OR_NULL(dev->traceDir) ) dev->traceDir = NULL;
+   else debugfs_create_file("trace", 0444, dev->traceDir, dev, &DmaTraceOps);
+
    // Remap the I/O register block so that it can be safely accessed.
    if ( Dma_MapReg(dev) < 0 ) return(-1);
 
    // Init descriptors
    for (x=0; x < DMA_MAX_DEST; x++) dev->desc[x] = NULL;
+   for (x=0; x < DMA_MAX_SECONDARY; x++) dev->secDesc[x] = NULL;
+   dev->secCount = 0;
+   INIT_LIST_HEAD(&(dev->descList));
+   memset(&(dev->irqStats),0,sizeof(struct DmaIrqStats));
+   memset(&(dev->writeHwStats),0,sizeof(struct DmaLockStats));
+   memset(&(dev->commandStats),0,sizeof(struct DmaLockStats));
+   memset(&(dev->maskStats),0,sizeof(struct DmaLockStats));
+   memset(&(dev->descStats),0,sizeof(struct DmaLockStats));
 
    // Init locks
    spin_lock_init(&(dev->writeHwLock));
    spin_lock_init(&(dev->commandLock));
    spin_lock_init(&(dev->maskLock));
+   spin_lock_init(&(dev->descLock));
+   spin_lock_init(&(dev->irqStatsLock));
 
    // Create tx buffers
    dev_info(dev->device,"Init: Creating %i TX Buffers. Size=%i Bytes. Mode=%i.\n",
@@ -182,10 +257,16 @@ int Dma_Init(struct DmaDevice *dev) {
    // Call card specific init
    dev->hwFunc->init(dev);
 
-   // Set interrupt
+   // Set interrupt, ring processing is deferred to irq thread when budget is set
    if ( dev->irq != 0 ) {
-      dev_info(dev->device,"Init: IRQ %d\n", dev->irq);
-      res = request_irq( dev->irq, dev->hwFunc->irq, IRQF_SHARED, dev->devName, (void*)dev);
+      if ( (dev->hwFunc->irqThread != NULL) && (dev->cfgIrqBudget > 0) ) {
+         dev_info(dev->device,"Init: IRQ %d, threaded with budget %d\n", dev->irq, dev->cfgIrqBudget);
+         res = request_threaded_irq( dev->irq, dev->hwFunc->irq, dev->hwFunc->irqThread, IRQF_SHARED, dev->devName, (void*)dev);
+      }
+      else {
+         dev_info(dev->device,"Init: IRQ %d\n", dev->irq);
+         res = request_irq( dev->irq, dev->hwFunc->irq, IRQF_SHARED, dev->devName, (void*)dev);
+      }
 
       // Result of request IRQ from OS.
       if (res < 0) {
@@ -196,6 +277,10 @@ int Dma_Init(struct DmaDevice *dev) {
 
    // Enable card
    dev->hwFunc->enable(dev);
+
+   // Start throughput sampling
+   dev->seriesTot.time = ktime_get_ns();
+   schedule_delayed_work(&(dev->seriesWork),msecs_to_jiffies(dev->cfgSample));
    return 0;
 }
 
@@ -208,6 +293,14 @@ void  Dma_Clean(struct DmaDevice *dev) {
    remove_proc_entry(dev->devName,NULL);
    cdev_del(&(dev->charDev));
 
+   // Stop throughput sampling before buffers are freed
+   if ( dev->series != NULL ) cancel_delayed_work_sync(&(dev->seriesWork));
+
+   // Cleanup trace, drop debug key reference
+   debugfs_remove_recursive(dev->traceDir);
+   Dma_SetDebug(dev,0);
+   Dma_SetLockStats(dev,0);
+
    // Unregister Device Driver this is neccessary but it is causing a kernel crash on removal.
    if ( gCl != NULL ) device_destroy(gCl, dev->devNum);
    else dev_warn(dev->device,"Clean: gCl is already NULL.\n");
@@ -230,12 +323,19 @@ void  Dma_Clean(struct DmaDevice *dev) {
    // Release memory region
    release_mem_region(dev->baseAddr, dev->baseSize);
 
-   // Release IRQ
-   if ( dev->irq != 0 ) free_irq(dev->irq, dev);
+   // Release IRQ, affinity hint must be cleared first
+   if ( dev->irq != 0 ) {
+      irq_set_affinity_hint(dev->irq, NULL);
+      free_irq(dev->irq, dev);
+   }
 
    // Unmap
    iounmap(dev->base);
 
+   vfree(dev->trace);
+   vfree(dev->destStats);
+   vfree(dev->series);
+
    if (gDmaDevCount == 0 && gCl != NULL) {
       dev_info(dev->device,"Clean: Destroying device class\n");
    }
@@ -263,6 +363,15 @@ int Dma_Open(struct inode *inode, struct file *filp) {
    dmaQueueInit(&(desc->q),dev->cfgRxCount);
    desc->async_queue = NULL;
    desc->dev = dev;
+   desc->ovfMode = DMA_OVF_BLOCK;
+   desc->pid = task_tgid_nr(current);
+   desc->secIdx = -1;
+   atomic_set(&(desc->secHeld),0);
+
+   // Add to device list
+   dmaSpinLock(&dev->descLock,&dev->descStats);
+   list_add_tail(&(desc->list),&(dev->descList));
+   spin_unlock(&dev->descLock);
 
    // Store for later
    filp->private_data = desc;
@@ -281,30 +390,37 @@ int Dma_Release(struct inode *inode, struct file *filp) {
    unsigned long iflags;
    uint32_t x;
    uint32_t cnt;
-   uint32_t destByte;
-   uint32_t destBit;
 
    desc = (struct DmaDesc *)filp->private_data;
    dev  = desc->dev;
 
    // Make sure we can't receive data while adjusting mask flags
-   spin_lock_irqsave(&dev->maskLock,iflags);
+   dmaSpinLockIrqSave(&dev->maskLock,&dev->maskStats,iflags);
+
+   // Clear secondary slot
+   if ( desc->secIdx >= 0 ) {
+      dev->secDesc[desc->secIdx] = NULL;
+      dev->secCount--;
+   }
 
    // Clear pointers
-   for (x=0; x < DMA_MAX_DEST; x++) {
-      destByte = x / 8;
-      destBit  = 1 << (x % 8);
-      if ( (destBit & desc->destMask[destByte]) != 0 ) dev->desc[x] = NULL;
+   else {
+      for_each_set_bit(x,desc->destBits,DMA_MAX_DEST) dev->desc[x] = NULL;
    }
 
    spin_unlock_irqrestore(&dev->maskLock,iflags);
 
+   // Remove from device list
+   dmaSpinLock(&dev->descLock,&dev->descStats);
+   list_del(&(desc->list));
+   spin_unlock(&dev->descLock);
+
    if (desc->async_queue) Dma_Fasync(-1,filp,0);
 
    // Release buffers
    cnt = 0;
    while ( (buff = dmaQueuePop(&(desc->q))) != NULL ) {
-      dev->hwFunc->retRxBuffer(dev,&buff,1);
+      if ( Dma_RxRelease(desc,buff) ) dev->hwFunc->retRxBuffer(dev,&buff,1);
       cnt++;
    }
    if ( cnt > 0 ) dev_info(dev->device,"Release: Removed %i buffers from closed device.\n", cnt);
@@ -316,7 +432,13 @@ int Dma_Release(struct inode *inode, struct file *filp) {
 
       if ( buff->userHas == desc ) {
          buff->userHas = NULL;
-         dev->hwFunc->retRxBuffer(dev,&buff,1);
+         if ( Dma_RxRelease(desc,buff) ) dev->hwFunc->retRxBuffer(dev,&buff,1);
+         cnt++;
+      }
+
+      // Held by secondary reader
+      else if ( (desc->secIdx >= 0) && test_bit(desc->secIdx,&(buff->secHas)) ) {
+         if ( Dma_RxRelease(desc,buff) ) dev->hwFunc->retRxBuffer(dev,&buff,1);
          cnt++;
       }
    }
@@ -355,6 +477,7 @@ ssize_t Dma_Read(struct file *filp, char *buffer, size_t count, loff_t *f_pos) {
    size_t             rCnt;
    ssize_t            bCnt;
    ssize_t            x;
+   uint64_t           now;
    struct DmaDesc   * desc;
    struct DmaDevice * dev;
 
@@ -380,8 +503,11 @@ ssize_t Dma_Read(struct file *filp, char *buffer, size_t count, loff_t *f_pos) {
 
    // Get buffers
    bCnt = dmaQueuePopList(&(desc->q),buff,rCnt);
+   now  = ktime_get_ns();
 
    for (x = 0; x < bCnt; x++ ) {
+      trace_dma_read(buff[x]);
+      dmaHistAdd(&(desc->queueLat),dmaAgeUs(now,buff[x]->qTime));
 
       // Report frame error
       if ( buff[x]->error )
@@ -398,8 +524,13 @@ ssize_t Dma_Read(struct file *filp, char *buffer, size_t count, loff_t *f_pos) {
       if ( sizeof(void *) == 4 || rd[x].is32 ) dp = (void *)(rd[x].data & 0xFFFFFFFF);
       else dp = (void *)rd[x].data;
 
-      // if pointer is zero, index is used
-      if ( dp == 0 ) buff[x]->userHas = desc;
+      // if pointer is zero, index is used, secondary ownership is tracked in buffer
+      if ( dp == 0 ) {
+         if ( desc->secIdx < 0 ) {
+            buff[x]->userHas = desc;
+            buff[x]->rdTime  = now;
+         }
+      }
 
       // Copy data if pointer is provided
       else {
@@ -419,15 +550,12 @@ ssize_t Dma_Read(struct file *filp, char *buffer, size_t count, loff_t *f_pos) {
             rd[x].ret = -1;
          }
 
-         // Return entry to RX queue
-         dev->hwFunc->retRxBuffer(dev,&(buff[x]),1);
+         // Return entry to RX queue once all holders are done
+         if ( Dma_RxRelease(desc,buff[x]) ) dev->hwFunc->retRxBuffer(dev,&(buff[x]),1);
       }
 
       // Debug if enabled
-      if ( dev->debug > 0 ) {
-         dev_info(dev->device,"Read: Ret=%i, Dest=%i, Flags=0x%.8x, Error=%i.\n",
-            rd[x].ret, rd[x].dest, rd[x].flags, rd[x].error);
-      }
+      if ( dmaDebug(dev) ) Dma_Trace(dev,DMA_TRACE_READ,rd[x].index,rd[x].dest,rd[x].ret,rd[x].flags,rd[x].error);
    }
    kfree(buff);
 
@@ -500,12 +628,23 @@ ssize_t Dma_Write(struct file *filp, const char* buffer, size_t count, loff_t* f
          dev_warn(dev->device,"Write: Invalid index posted: %i.\n", wr.index);
          return(-1);
       }
+
+      // Receive buffer still held by secondary readers
+      if ( (buff->secHas != 0) || (atomic_read(&(buff->refCnt)) > 1) ) {
+         dev_warn(dev->device,"Write: Buffer %i is shared with secondary readers.\n", wr.index);
+         return(-1);
+      }
+      atomic_set(&(buff->refCnt),0);
+      if ( buff->userHas != NULL ) dmaHoldDone(buff->userHas,buff);
       buff->userHas = NULL;
    }      
 
    // Copy data if pointer is provided
    else {
 
+      // Reclaim lazy transmit completions below low water mark
+      if ( (dev->hwFunc->txReap != NULL) && (dmaQueueCount(&(dev->tq)) < dev->cfgTxLazy) ) dev->hwFunc->txReap(dev);
+
       // Read transmit buffer queue, return 0 if error
       if ((buff = dmaQueuePop(&(dev->tq))) == NULL ) return (0);
 
@@ -525,13 +664,11 @@ ssize_t Dma_Write(struct file *filp, const char* buffer, size_t count, loff_t* f
    buff->size   = wr.size;
 
    // board specific call 
+   trace_dma_tx_submit(buff);
    res = dev->hwFunc->sendBuffer(dev,&buff,1);
 
    // Debug
-   if ( dev->debug > 0 ) {
-      dev_info(dev->device,"Write: Size=%i, Dest=%i, Flags=0x%.8x, res=%li\n",
-          buff->size, buff->dest, buff->flags, res);
-   }
+   if ( dmaDebug(dev) ) Dma_Trace(dev,DMA_TRACE_WRITE,buff->index,buff->dest,buff->size,buff->flags,(res < 0));
    if ( res < 0) return(res);
    else return buff->size;
 }
@@ -549,6 +686,7 @@ ssize_t Dma_Ioctl(struct file *filp, uint32_t cmd, unsigned long arg) {
    uint32_t   cnt;
    uint32_t   bCnt;
    uint32_t * indexes;
+   unsigned long iflags;
 
    desc = (struct DmaDesc *)filp->private_data;
    dev  = desc->dev;
@@ -583,8 +721,8 @@ ssize_t Dma_Ioctl(struct file *filp, uint32_t cmd, unsigned long arg) {
 
       // Set debug level
       case DMA_Set_Debug:
-         dev->debug = arg;
-         dev_info(dev->device,"debug set to %u.\n",(uint32_t)arg);
+         Dma_SetDebug(dev,arg);
+         dev_info(dev->device,"debug set to %u, trace sample %u.\n",dev->debug,dev->traceSample);
          return(0);
          break;
 
@@ -616,16 +754,22 @@ ssize_t Dma_Ioctl(struct file *filp, uint32_t cmd, unsigned long arg) {
 
             // Attempt to find buffer in RX list
             if ( (buff = dmaGetBufferList(&(dev->rxBuffers),indexes[x])) != NULL ) {
+               trace_dma_ret_index(buff);
 
-               // Only return if owned by current desc
+               // Only return if owned by current desc and no other holders remain
                if ( buff->userHas == desc ) {
+                  dmaHoldDone(desc,buff);
                   buff->userHas = NULL;
-                  buffList[bCnt++] = buff;
+                  if ( Dma_RxRelease(desc,buff) ) buffList[bCnt++] = buff;
                }
+
+               // Held by secondary reader
+               else if ( (desc->secIdx >= 0) && Dma_RxRelease(desc,buff) ) buffList[bCnt++] = buff;
             }
 
             // Attempt to find in tx list
             else if ( (buff = dmaGetBufferList(&(dev->txBuffers),indexes[x])) != NULL ) {
+               trace_dma_ret_index(buff);
 
                // Only return if owned by current desc
                if ( buff->userHas == desc ) {
@@ -653,6 +797,9 @@ ssize_t Dma_Ioctl(struct file *filp, uint32_t cmd, unsigned long arg) {
       // Request a write buffer index
       case DMA_Get_Index:
 
+         // Reclaim lazy transmit completions
+         if ( dev->hwFunc->txReap != NULL ) dev->hwFunc->txReap(dev);
+
          // Read transmit buffer queue
          buff = dmaQueuePop(&(dev->tq));
 
@@ -661,8 +808,7 @@ ssize_t Dma_Ioctl(struct file *filp, uint32_t cmd, unsigned long arg) {
          else {
             buff->userHas = desc;
 
-            if ( dev->debug > 0 ) 
-               dev_info(dev->device,"Command: Returning buffer %i to user\n",buff->index);
+            if ( dmaDebug(dev) ) Dma_Trace(dev,DMA_TRACE_INDEX,buff->index,0,0,0,0);
             return(buff->index);
          }
          break;
@@ -682,6 +828,80 @@ ssize_t Dma_Ioctl(struct file *filp, uint32_t cmd, unsigned long arg) {
          return(Dma_ReadRegister(dev,arg));
          break;
 
+      // Register transaction list
+      case DMA_Reg_Vector:
+         return(Dma_RegisterVector(dev,cmd,arg));
+         break;
+
+      // Set receive queue overflow mode
+      case DMA_Set_Overflow:
+         return(Dma_SetOverflow(desc,arg));
+         break;
+
+      // Add destination
+      case DMA_Add_Dest:
+         return(Dma_AddDest(desc,arg));
+         break;
+
+      // Remove destination
+      case DMA_Rem_Dest:
+         return(Dma_RemDest(desc,arg));
+         break;
+
+      // Take destination from current owner
+      case DMA_Take_Dest:
+         return(Dma_TakeDest(desc,arg));
+         break;
+
+      // Get throughput time series
+      case DMA_Get_Series:
+         return(Dma_GetSeries(dev,arg));
+         break;
+
+      // Enable lock contention statistics
+      case DMA_Set_LockStats:
+         Dma_SetLockStats(dev,arg);
+         return(0);
+         break;
+
+      // Reset interrupt handler histograms
+      case DMA_Reset_IrqStats:
+         spin_lock_irqsave(&(dev->irqStatsLock),iflags);
+         memset(&(dev->irqStats),0,sizeof(struct DmaIrqStats));
+         spin_unlock_irqrestore(&(dev->irqStatsLock),iflags);
+         return(0);
+         break;
+
+      // Get receive latency histograms
+      case DMA_Get_Latency:
+         return(Dma_GetLatency(desc,arg));
+         break;
+
+      // Get destination traffic counters
+      case DMA_Get_DestStats:
+         return(Dma_GetDestStats(desc,arg));
+         break;
+
+      // Get drop counters
+      case DMA_Get_Drops:
+         return(Dma_GetDrops(desc,arg));
+         break;
+
+      // Attach as secondary reader
+      case DMA_Set_Secondary:
+         return(Dma_SetSecondary(desc,arg));
+         break;
+
+      // Set receive filter
+      case DMA_Set_Filter:
+         return(Dma_SetFilter(desc,cmd,arg));
+         break;
+
+      // Get receive filter
+      case DMA_Get_Filter:
+         return(Dma_GetFilter(desc,cmd,arg));
+         break;
+
       // All other commands handled by card specific functions   
       default:
          return(dev->hwFunc->command(dev,cmd,arg));
@@ -701,6 +921,9 @@ uint32_t Dma_Poll(struct file *filp, poll_table *wait ) {
    desc = (struct DmaDesc *)filp->private_data;
    dev  = desc->dev;
 
+   // Reclaim lazy transmit completions
+   if ( dev->hwFunc->txReap != NULL ) dev->hwFunc->txReap(dev);
+
    dmaQueuePoll(&(dev->tq),filp,wait);
    dmaQueuePoll(&(desc->q),filp,wait);
 
@@ -736,6 +959,16 @@ int Dma_Mmap(struct file *filp, struct vm_area_struct *vma) {
    // Compute index, rx and tx buffers are the same size
    idx = (uint32_t)(offset / (off_t)dev->cfgSize);
 
+   // Destination counters, buffers take precedence over the counters offset
+   if ( (offset == DMA_STATS_OFFSET) && (dmaGetBuffer(dev,idx) == NULL) ) {
+      if ( (vma->vm_flags & VM_WRITE) || (vsize > DMA_MAX_DEST * sizeof(struct DmaDestStats)) ) {
+         dev_warn(dev->device,"map: Counters must be mapped read only, size %li.\n",vsize);
+         return(-1);
+      }
+      vma->vm_flags &= ~VM_MAYWRITE;
+      return(remap_vmalloc_range(vma,dev->destStats,0));
+   }
+
    // Attempt to find buffer
    if ( (buff = dmaGetBuffer(dev,idx)) == NULL ) {
       dev_warn(dev->device,"map: Invalid index posted: %i.\n", idx);
@@ -790,6 +1023,202 @@ int Dma_Fasync(int fd, struct file *filp, int mode) {
 }
 
 
+// Show histogram in proc file, empty bins are skipped
+void Dma_HistShow(struct seq_file *s, const char *name, struct DmaHist *hist) {
+   uint32_t lo;
+   uint32_t hi;
+   uint32_t x;
+
+   seq_printf(s,"%21s : max %u\n",name,hist->max);
+
+   for (x=0; x < DMA_HIST_BINS; x++) {
+      if ( hist->bins[x] == 0 ) continue;
+      lo = (x == 0) ? 0 : (1 << (x-1));
+      hi = (x == 0) ? 0 : ((x == (DMA_HIST_BINS-1)) ? 0xFFFFFFFF : ((1 << x) - 1));
+      seq_printf(s,"%21s   %10u - %10u : %u\n","",lo,hi,hist->bins[x]);
+   }
+}
+
+// Take throughput sample
+// Runs from a delayed work every cfgSample mS, counters are summed over all dests
+// and the difference from the previous sample is stored in the ring.
+void Dma_SeriesWork(struct work_struct *work) {
+   struct DmaDevice    * dev;
+   struct DmaDestStats * st;
+   struct DmaBuffer    * buff;
+   struct DmaSample    * smp;
+   struct DmaSample      tot;
+   uint32_t x;
+
+   dev = container_of(to_delayed_work(work),struct DmaDevice,seriesWork);
+   memset(&tot,0,sizeof(struct DmaSample));
+
+   for (x=0; x < DMA_MAX_DEST; x++) {
+      st = &(dev->destStats[x]);
+      tot.rxFrames += st->rxFrames;
+      tot.rxBytes  += st->rxBytes;
+      tot.txFrames += st->txFrames;
+      tot.txBytes  += st->txBytes;
+      tot.rxErrors += st->rxErrors;
+      tot.drops    += st->ovfDrops + st->idleDrops;
+   }
+
+   for (x=dev->rxBuffers.baseIdx; x < (dev->rxBuffers.baseIdx + dev->rxBuffers.count); x++) {
+      buff = dmaGetBufferList(&(dev->rxBuffers),x);
+      if ( buff->inHw ) tot.freeDepth++;
+   }
+   tot.time = ktime_get_ns();
+
+   mutex_lock(&(dev->seriesLock));
+   smp = &(dev->series[dev->seriesSeq % DMA_SERIES_SIZE]);
+   smp->time      = tot.time;
+   smp->period    = dmaAgeUs(tot.time,dev->seriesTot.time);
+   smp->rxFrames  = tot.rxFrames - dev->seriesTot.rxFrames;
+   smp->rxBytes   = tot.rxBytes  - dev->seriesTot.rxBytes;
+   smp->txFrames  = tot.txFrames - dev->seriesTot.txFrames;
+   smp->txBytes   = tot.txBytes  - dev->seriesTot.txBytes;
+   smp->rxErrors  = tot.rxErrors - dev->seriesTot.rxErrors;
+   smp->drops     = tot.drops    - dev->seriesTot.drops;
+   smp->freeDepth = tot.freeDepth;
+   memcpy(&(dev->seriesTot),&tot,sizeof(struct DmaSample));
+   dev->seriesSeq++;
+   mutex_unlock(&(dev->seriesLock));
+
+   schedule_delayed_work(&(dev->seriesWork),msecs_to_jiffies(dev->cfgSample));
+}
+
+// Get throughput time series, samples are copied oldest first
+// Returns number of samples
+int32_t Dma_GetSeries(struct DmaDevice *dev, uint64_t arg) {
+   struct DmaSeries * series;
+   uint32_t count;
+   uint32_t first;
+   uint32_t len;
+   int32_t  ret;
+
+   series = (struct DmaSeries *)arg;
+
+   mutex_lock(&(dev->seriesLock));
+   count = (dev->seriesSeq < DMA_SERIES_SIZE) ? dev->seriesSeq : DMA_SERIES_SIZE;
+   first = (dev->seriesSeq - count) % DMA_SERIES_SIZE;
+   len   = ((first + count) > DMA_SERIES_SIZE) ? (DMA_SERIES_SIZE - first) : count;
+
+   ret  = put_user(dev->cfgSample,&(series->interval));
+   ret |= put_user(count,&(series->count));
+   ret |= copy_to_user(&(series->seq),&(dev->seriesSeq),sizeof(uint64_t));
+   ret |= copy_to_user(&(series->sample[0]),&(dev->series[first]),len * sizeof(struct DmaSample));
+   if ( count > len )
+      ret |= copy_to_user(&(series->sample[len]),&(dev->series[0]),(count - len) * sizeof(struct DmaSample));
+   mutex_unlock(&(dev->seriesLock));
+
+   if ( ret ) {
+      dev_warn(dev->device,"Dma_GetSeries: copy_to_user failed. ret=%i, user=%p\n", ret, (void *)arg);
+      return(-1);
+   }
+   return(count);
+}
+
+// Show lock contention in proc file
+void Dma_LockShow(struct seq_file *s, const char *name, struct DmaLockStats *st) {
+   seq_printf(s,"%21s : Count %llu, Contended %llu, Wait %llu nS, Max %llu nS\n",
+      name,st->count,st->contended,st->waitNs,st->maxNs);
+}
+
+// Enable or disable lock contention statistics
+// Counters are kept while disabled and accumulate across enables
+void Dma_SetLockStats(struct DmaDevice *dev, uint32_t enable) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,3,0)
+   if ( enable && (! test_and_set_bit(DMA_KEY_LOCK,&(dev->keyFlags))) ) static_branch_inc(&DmaLockKey);
+   if ( (! enable) && test_and_clear_bit(DMA_KEY_LOCK,&(dev->keyFlags)) ) static_branch_dec(&DmaLockKey);
+#else
+   if ( enable && (! test_and_set_bit(DMA_KEY_LOCK,&(dev->keyFlags))) ) static_key_slow_inc(&DmaLockKey);
+   if ( (! enable) && test_and_clear_bit(DMA_KEY_LOCK,&(dev->keyFlags)) ) static_key_slow_dec(&DmaLockKey);
+#endif
+}
+
+// Set debug level and trace sampling
+// Bits 7:0 = level, bits 31:16 = record one in N trace events, 0 records all
+void Dma_SetDebug(struct DmaDevice *dev, uint32_t arg) {
+   uint8_t level;
+
+   level = arg & 0xFF;
+   dev->traceSample = ((arg >> 16) == 0) ? 1 : (arg >> 16);
+
+   // Key reference follows the device flag so concurrent calls stay balanced
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,3,0)
+   if ( (level > 0) && (! test_and_set_bit(DMA_KEY_DEBUG,&(dev->keyFlags))) ) static_branch_inc(&DmaDebugKey);
+   if ( (level == 0) && test_and_clear_bit(DMA_KEY_DEBUG,&(dev->keyFlags)) ) static_branch_dec(&DmaDebugKey);
+#else
+   if ( (level > 0) && (! test_and_set_bit(DMA_KEY_DEBUG,&(dev->keyFlags))) ) static_key_slow_inc(&DmaDebugKey);
+   if ( (level == 0) && test_and_clear_bit(DMA_KEY_DEBUG,&(dev->keyFlags)) ) static_key_slow_dec(&DmaDebugKey);
+#endif
+   dev->debug = level;
+}
+
+// Record debug trace entry
+// Lock free, safe in interrupt context. Slots are claimed with an atomic
+// counter and the oldest entries are overwritten.
+void Dma_Trace(struct DmaDevice *dev, uint32_t event, uint32_t index, uint32_t dest, uint32_t size, uint32_t flags, uint32_t error) {
+   struct DmaTraceEntry * ent;
+   uint32_t seq;
+
+   if ( dev->trace == NULL ) return;
+   if ( (dev->traceSample > 1) && ((atomic_inc_return(&(dev->traceCount)) % dev->traceSample) != 0) ) return;
+
+   seq = atomic_inc_return(&(dev->traceHead));
+   ent = &(dev->trace[seq & (DMA_TRACE_SIZE-1)]);
+
+   ent->seq = 0;
+   smp_wmb();
+   ent->event = event;
+   ent->time  = ktime_get_ns();
+   ent->index = index;
+   ent->dest  = dest;
+   ent->size  = size;
+   ent->flags = flags;
+   ent->error = error;
+   smp_wmb();
+   ent->seq = seq;
+}
+
+// Open debugfs trace file
+int Dma_TraceOpen(struct inode *inode, struct file *file) {
+   return(single_open(file, Dma_TraceShow, inode->i_private));
+}
+
+// Show debugfs trace file, oldest entry first
+// Entries rewritten while reading are skipped
+int Dma_TraceShow(struct seq_file *s, void *v) {
+   struct DmaDevice * dev;
+   struct DmaTraceEntry ent;
+   uint32_t head;
+   uint32_t cnt;
+   uint32_t seq;
+   uint32_t x;
+   uint32_t n;
+
+   dev = (struct DmaDevice *)s->private;
+   if ( dev->trace == NULL ) return(0);
+
+   head = atomic_read(&(dev->traceHead));
+   cnt  = (head < DMA_TRACE_SIZE) ? head : DMA_TRACE_SIZE;
+   seq_printf(s,"%10s %20s %8s %8s %6s %10s %10s %10s\n","seq","time_ns","event","index","dest","size","flags","error");
+
+   for (n=0; n < cnt; n++) {
+      x = head - cnt + 1 + n;
+      seq = dev->trace[x & (DMA_TRACE_SIZE-1)].seq;
+      smp_rmb();
+      ent = dev->trace[x & (DMA_TRACE_SIZE-1)];
+      smp_rmb();
+      if ( (seq != x) || (dev->trace[x & (DMA_TRACE_SIZE-1)].seq != seq) ) continue;
+
+      seq_printf(s,"%10u %20llu %8s %8u %6u %10u 0x%.8x 0x%.8x\n",seq,ent.time,
+                 (ent.event < (sizeof(DmaTraceNames)/sizeof(char *)))?DmaTraceNames[ent.event]:"unknown",
+                 ent.index,ent.dest,ent.size,ent.flags,ent.error);
+   }
+   return(0);
+}
+
 // Open proc file
 int Dma_ProcOpen(struct inode *inode, struct file *file) {
    struct seq_file *sf;
@@ -833,17 +1262,25 @@ void Dma_SeqStop(struct seq_file *s, void *v) {
 int Dma_SeqShow(struct seq_file *s, void *v) {
    struct   DmaBuffer * buff;
    struct   DmaDevice * dev;
+   struct   DmaDesc   * desc;
    uint32_t max;
    uint32_t min;
    uint32_t sum;
    uint32_t avg;
    uint32_t miss;
    uint32_t userCnt;
+   uint32_t secCnt;
    uint32_t hwCnt;
    uint32_t hwQCnt;
    uint32_t qCnt;
+   uint32_t held;
+   uint32_t age;
    uint32_t x;
 
+   struct DmaLockStats lock;
+   struct DmaSample  * smp;
+   uint64_t            seq;
+
    dev = (struct DmaDevice *)s->private;
 
    // Call applications specific show function first
@@ -853,12 +1290,54 @@ int Dma_SeqShow(struct seq_file *s, void *v) {
    seq_printf(s,"-------------- General --------------------\n");
    seq_printf(s,"          Dma Version : 0x%x\n",DMA_VERSION);
    seq_printf(s,"          Git Version : " GITV "\n\n");
+   seq_printf(s,"-------------- IRQ Stats ------------------\n");
+   seq_printf(s,"            IRQ Count : %llu\n",dev->irqStats.count);
+   Dma_HistShow(s,"Handler Time (nS)",&(dev->irqStats.time));
+   Dma_HistShow(s,"Rx Per IRQ",&(dev->irqStats.rx));
+   Dma_HistShow(s,"Tx Per IRQ",&(dev->irqStats.tx));
+   Dma_HistShow(s,"Refill Per IRQ",&(dev->irqStats.refill));
+   seq_printf(s,"\n");
+   seq_printf(s,"-------------- Lock Stats -----------------\n");
+   seq_printf(s,"              Enabled : %u\n",test_bit(DMA_KEY_LOCK,&(dev->keyFlags)));
+   Dma_LockShow(s,"Mask Lock",&(dev->maskStats));
+   Dma_LockShow(s,"Write Hw Lock",&(dev->writeHwStats));
+   Dma_LockShow(s,"Command Lock",&(dev->commandStats));
+   Dma_LockShow(s,"Desc Lock",&(dev->descStats));
+   Dma_LockShow(s,"Tx Queue Lock",&(dev->tq.lockStats));
+
+   memset(&lock,0,sizeof(struct DmaLockStats));
+   dmaSpinLock(&dev->descLock,&dev->descStats);
+   list_for_each_entry(desc,&(dev->descList),list) {
+      lock.count     += desc->q.lockStats.count;
+      lock.contended += desc->q.lockStats.contended;
+      lock.waitNs    += desc->q.lockStats.waitNs;
+      if ( desc->q.lockStats.maxNs > lock.maxNs ) lock.maxNs = desc->q.lockStats.maxNs;
+   }
+   spin_unlock(&dev->descLock);
+   Dma_LockShow(s,"Rx Queue Locks",&lock);
+   seq_printf(s,"\n");
+   seq_printf(s,"-------------- Throughput -----------------\n");
+   seq_printf(s,"      Sample Interval : %u mS\n",dev->cfgSample);
+
+   mutex_lock(&(dev->seriesLock));
+   seq = (dev->seriesSeq < DMA_SERIES_PROC) ? 0 : (dev->seriesSeq - DMA_SERIES_PROC);
+   for (; seq < dev->seriesSeq; seq++) {
+      smp = &(dev->series[seq % DMA_SERIES_SIZE]);
+      if ( smp->period == 0 ) continue;
+      seq_printf(s,"        Sample %6llu : Rx %llu fps %llu Bps, Tx %llu fps %llu Bps, Errors %u, Drops %u, Free %u\n",seq,
+         div_u64(smp->rxFrames * 1000000,smp->period),div_u64(smp->rxBytes * 1000000,smp->period),
+         div_u64(smp->txFrames * 1000000,smp->period),div_u64(smp->txBytes * 1000000,smp->period),
+         smp->rxErrors,smp->drops,smp->freeDepth);
+   }
+   mutex_unlock(&(dev->seriesLock));
+   seq_printf(s,"\n");
    seq_printf(s,"-------------- Read Buffers ---------------\n");
    seq_printf(s,"         Buffer Count : %u\n",dev->rxBuffers.count);
    seq_printf(s,"          Buffer Size : %u\n",dev->cfgSize);
    seq_printf(s,"          Buffer Mode : %u\n",dev->cfgMode);
 
    userCnt = 0;
+   secCnt  = 0;
    hwCnt   = 0;
    hwQCnt   = 0;
    qCnt    = 0;
@@ -877,7 +1356,10 @@ int Dma_SeqShow(struct seq_file *s, void *v) {
       if (  buff->inHw   &&  buff->inQ   ) hwQCnt++;
       if ( (!buff->inHw) &&  buff->inQ   ) qCnt++;
 
-      if ( buff->userHas == NULL && buff->inHw == 0 && buff->inQ == 0 ) miss++;
+      if ( buff->userHas == NULL && buff->inHw == 0 && buff->inQ == 0 ) {
+         if ( buff->secHas != 0 ) secCnt++;
+         else miss++;
+      }
 
       sum += buff->count;
    }
@@ -888,6 +1370,7 @@ int Dma_SeqShow(struct seq_file *s, void *v) {
    else avg = sum/dev->rxBuffers.count;
 
    seq_printf(s,"      Buffers In User : %u\n",userCnt);
+   seq_printf(s," Buffers In Secondary : %u\n",secCnt);
    seq_printf(s,"        Buffers In Hw : %u\n",hwCnt);
    seq_printf(s,"  Buffers In Pre-Hw Q : %u\n",hwQCnt);
    seq_printf(s,"  Buffers In Rx Queue : %u\n",qCnt);
@@ -943,56 +1426,183 @@ int Dma_SeqShow(struct seq_file *s, void *v) {
    seq_printf(s,"       Tot Buffer Use : %u\n",sum);
    seq_printf(s,"\n");
 
+   seq_printf(s,"-------------- Descriptors ----------------\n");
+   dmaSpinLock(&dev->descLock,&dev->descStats);
+   list_for_each_entry(desc,&(dev->descList),list) {
+      if ( desc->secIdx >= 0 )
+         seq_printf(s,"    Pid %6i : Secondary %i, Held %u, Max %u, Prescale %u, Rate %u, Queued %u, Drops %u\n",
+            desc->pid,desc->secIdx,atomic_read(&(desc->secHeld)),desc->secMax,desc->secPrescale,desc->secRate,
+            dmaQueueCount(&(desc->q)),desc->dropCount);
+      else
+         seq_printf(s,"    Pid %6i : Overflow Mode %u, Depth %u, Queued %u, Drops %u, Filters %u\n",
+            desc->pid,desc->ovfMode,desc->ovfDepth,dmaQueueCount(&(desc->q)),desc->dropCount,desc->filterCount);
+
+      age = Dma_HeldAge(desc,&held);
+      seq_printf(s,"       Latency : Queue Max %u uS, Hold Max %u uS, Held %u, Oldest %u uS\n",
+         desc->queueLat.max,desc->holdLat.max,held,age);
+      if ( desc->queueLat.max != 0 ) Dma_HistShow(s,"Queue Time (uS)",&(desc->queueLat));
+      if ( desc->holdLat.max != 0 ) Dma_HistShow(s,"Hold Time (uS)",&(desc->holdLat));
+   }
+   spin_unlock(&dev->descLock);
+   seq_printf(s,"\n");
+
+   seq_printf(s,"-------------- Dest Drops -----------------\n");
+   for (x=0; x < DMA_MAX_DEST; x++) {
+      if ( (dev->destStats[x].ovfDrops != 0) || (dev->destStats[x].idleDrops != 0) )
+         seq_printf(s,"           Dest %4u : Overflow %u, No Reader %u, Bytes %llu\n",
+                    x,dev->destStats[x].ovfDrops,dev->destStats[x].idleDrops,dev->destStats[x].dropBytes);
+   }
+   seq_printf(s,"\n");
+
    return 0;
 }
 
 // Set Mask
 int Dma_SetMaskBytes(struct DmaDevice *dev, struct DmaDesc *desc, uint8_t * mask ) {
    unsigned long iflags;
+   unsigned long * bits;
    uint32_t idx;
-   uint32_t destByte;
-   uint32_t destBit;
 
    // Can only be called once
    static const uint8_t zero[DMA_MASK_SIZE] = { 0 };
    if (memcmp(desc->destMask,zero,DMA_MASK_SIZE)) return(-1); 
 
+   // Secondary readers do not own destinations
+   if ( desc->secIdx >= 0 ) return(-1);
+
+   // Convert to bitmap before locking so only requested destinations are visited
+   if ( (bits = (unsigned long *)kzalloc(BITS_TO_LONGS(DMA_MAX_DEST) * sizeof(unsigned long),GFP_KERNEL)) == NULL ) {
+      dev_warn(dev->device,"Dma_SetMask: Failed to allocate dest bitmap.\n");
+      return(-ENOMEM);
+   }
+   for ( idx=0; idx < DMA_MAX_DEST; idx++ ) {
+      if ( (mask[idx / 8] & (1 << (idx % 8))) != 0 ) __set_bit(idx,bits);
+   }
+
    // Make sure we can't receive data while adjusting mask flags
    // Interrupts are disabled
-   spin_lock_irqsave(&dev->maskLock,iflags);
+   dmaSpinLockIrqSave(&dev->maskLock,&dev->maskStats,iflags);
 
    // First check if all lockable
-   for ( idx=0; idx < DMA_MAX_DEST; idx ++ ) {
-      destByte = idx / 8;
-      destBit  = 1 << (idx % 8);
-
-      // We want to get this one
-      if ( (mask[destByte] & destBit) != 0 ) {
-         if ( dev->desc[idx] != NULL ) {
-            spin_unlock_irqrestore(&dev->maskLock,iflags);
-            if (dev->debug > 0) dev_info(dev->device,"Dma_SetMask: Dest %i already mapped\n",idx);
-            return(-1);
-         }
+   for_each_set_bit(idx,bits,DMA_MAX_DEST) {
+      if ( dev->desc[idx] != NULL ) {
+         spin_unlock_irqrestore(&dev->maskLock,iflags);
+         if (dev->debug > 0) dev_info(dev->device,"Dma_SetMask: Dest %i already mapped\n",idx);
+         kfree(bits);
+         return(-1);
       }
    }
 
    // Next lock the ones we want
-   for ( idx=0; idx < DMA_MAX_DEST; idx ++ ) {
-      destByte = idx / 8;
-      destBit  = 1 << (idx % 8);
-
-      // We want to get this one
-      if ( (mask[destByte] & destBit) != 0 ) {
-         dev->desc[idx] = desc;
-         if (dev->debug > 0) dev_info(dev->device,"Dma_SetMask: Register dest for %i.\n", idx);
-      }
+   for_each_set_bit(idx,bits,DMA_MAX_DEST) {
+      dev->desc[idx] = desc;
+      if (dev->debug > 0) dev_info(dev->device,"Dma_SetMask: Register dest for %i.\n", idx);
    }
+   bitmap_copy(desc->destBits,bits,DMA_MAX_DEST);
    memcpy(desc->destMask,mask,DMA_MASK_SIZE);
 
    spin_unlock_irqrestore(&dev->maskLock,iflags);
+   kfree(bits);
    return(0);
 }
 
+// Add destination
+int32_t Dma_AddDest(struct DmaDesc *desc, uint32_t dest) {
+   struct DmaDevice * dev;
+   unsigned long iflags;
+
+   dev = desc->dev;
+
+   // Secondary readers do not own destinations
+   if ( (dest >= DMA_MAX_DEST) || (desc->secIdx >= 0) ) return(-1);
+
+   dmaSpinLockIrqSave(&dev->maskLock,&dev->maskStats,iflags);
+
+   if ( (dev->desc[dest] != NULL) && (dev->desc[dest] != desc) ) {
+      spin_unlock_irqrestore(&dev->maskLock,iflags);
+      if (dev->debug > 0) dev_info(dev->device,"Dma_AddDest: Dest %i already mapped\n",dest);
+      return(-1);
+   }
+
+   dev->desc[dest] = desc;
+   __set_bit(dest,desc->destBits);
+   desc->destMask[dest / 8] |= (1 << (dest % 8));
+
+   spin_unlock_irqrestore(&dev->maskLock,iflags);
+   if (dev->debug > 0) dev_info(dev->device,"Dma_AddDest: Register dest for %i.\n", dest);
+   return(0);
+}
+
+// Remove destination, frames already queued stay with the descriptor
+int32_t Dma_RemDest(struct DmaDesc *desc, uint32_t dest) {
+   struct DmaDevice * dev;
+   unsigned long iflags;
+
+   dev = desc->dev;
+
+   if ( dest >= DMA_MAX_DEST ) return(-1);
+
+   dmaSpinLockIrqSave(&dev->maskLock,&dev->maskStats,iflags);
+
+   if ( dev->desc[dest] != desc ) {
+      spin_unlock_irqrestore(&dev->maskLock,iflags);
+      return(-1);
+   }
+
+   dev->desc[dest] = NULL;
+   __clear_bit(dest,desc->destBits);
+   desc->destMask[dest / 8] &= ~(1 << (dest % 8));
+
+   spin_unlock_irqrestore(&dev->maskLock,iflags);
+   if (dev->debug > 0) dev_info(dev->device,"Dma_RemDest: Release dest for %i.\n", dest);
+   return(0);
+}
+
+// Take destination and queued frames from current owner
+// Frames for other destinations keep their order in the old owner queue
+// Returns number of frames moved
+int32_t Dma_TakeDest(struct DmaDesc *desc, uint32_t dest) {
+   struct DmaDevice * dev;
+   struct DmaDesc   * old;
+   struct DmaBuffer * buff;
+   unsigned long iflags;
+   uint32_t cnt;
+   uint32_t moved;
+
+   dev = desc->dev;
+
+   // Secondary readers do not own destinations
+   if ( (dest >= DMA_MAX_DEST) || (desc->secIdx >= 0) ) return(-1);
+
+   // Make sure we can't receive data while moving ownership
+   dmaSpinLockIrqSave(&dev->maskLock,&dev->maskStats,iflags);
+
+   old = dev->desc[dest];
+   dev->desc[dest] = desc;
+   __set_bit(dest,desc->destBits);
+   desc->destMask[dest / 8] |= (1 << (dest % 8));
+   moved = 0;
+
+   if ( (old != NULL) && (old != desc) ) {
+      __clear_bit(dest,old->destBits);
+      old->destMask[dest / 8] &= ~(1 << (dest % 8));
+
+      // Cycle through old owner queue once
+      cnt = dmaQueueCount(&(old->q));
+      while ( (cnt > 0) && ((buff = dmaQueuePopIrq(&(old->q))) != NULL) ) {
+         if ( (buff->dest == dest) && (dmaQueuePushIrq(&(desc->q),buff) == 0) ) moved++;
+         else dmaQueuePushIrq(&(old->q),buff);
+         cnt--;
+      }
+   }
+
+   spin_unlock_irqrestore(&dev->maskLock,iflags);
+
+   if ( (moved > 0) && desc->async_queue ) kill_fasync(&desc->async_queue, SIGIO, POLL_IN);
+   if (dev->debug > 0) dev_info(dev->device,"Dma_TakeDest: Took dest %i, moved %i frames.\n", dest, moved);
+   return(moved);
+}
+
 // Write Register
 int32_t Dma_WriteRegister(struct DmaDevice *dev, uint64_t arg) {
    int32_t  ret;
@@ -1036,3 +1646,282 @@ int32_t Dma_ReadRegister(struct DmaDevice *dev, uint64_t arg) {
    return(0);
 }
 
+// Set receive queue overflow mode
+int32_t Dma_SetOverflow(struct DmaDesc *desc, uint64_t arg) {
+   struct DmaOverflowData ovf;
+   int32_t ret;
+
+   if ((ret = copy_from_user(&ovf,(void *)arg,sizeof(struct DmaOverflowData)))) {
+      dev_warn(desc->dev->device,"Dma_SetOverflow: copy_from_user failed. ret=%i, user=%p kern=%p\n", ret, (void *)arg, &ovf);
+      return(-1);
+   }
+
+   if ( ovf.mode > DMA_OVF_DROP_OLD ) {
+      dev_warn(desc->dev->device,"Dma_SetOverflow: Invalid mode %i.\n",ovf.mode);
+      return(-1);
+   }
+
+   desc->ovfDepth = ovf.depth;
+   desc->ovfMode  = ovf.mode;
+   return(0);
+}
+
+// Get drop counters
+int32_t Dma_GetDrops(struct DmaDesc *desc, uint64_t arg) {
+   struct DmaDropData drop;
+   int32_t ret;
+
+   if ((ret = copy_from_user(&drop,(void *)arg,sizeof(struct DmaDropData)))) {
+      dev_warn(desc->dev->device,"Dma_GetDrops: copy_from_user failed. ret=%i, user=%p kern=%p\n", ret, (void *)arg, &drop);
+      return(-1);
+   }
+
+   drop.destDrops = (drop.dest < DMA_MAX_DEST) ? desc->dev->destStats[drop.dest].ovfDrops : 0;
+   drop.idleDrops = (drop.dest < DMA_MAX_DEST) ? desc->dev->destStats[drop.dest].idleDrops : 0;
+   drop.descDrops = desc->dropCount;
+
+   if ((ret = copy_to_user((void *)arg,&drop,sizeof(struct DmaDropData)))) {
+      dev_warn(desc->dev->device,"Dma_GetDrops: copy_to_user failed. ret=%i, user=%p kern=%p\n", ret, (void *)arg, &drop);
+      return(-1);
+   }
+   return(0);
+}
+
+// Get destination traffic counters
+int32_t Dma_GetDestStats(struct DmaDesc *desc, uint64_t arg) {
+   struct DmaDestStats stats;
+   int32_t ret;
+
+   if ((ret = copy_from_user(&stats,(void *)arg,sizeof(struct DmaDestStats)))) {
+      dev_warn(desc->dev->device,"Dma_GetDestStats: copy_from_user failed. ret=%i, user=%p kern=%p\n", ret, (void *)arg, &stats);
+      return(-1);
+   }
+
+   if ( stats.dest >= DMA_MAX_DEST ) {
+      dev_warn(desc->dev->device,"Dma_GetDestStats: Invalid dest %i.\n", stats.dest);
+      return(-1);
+   }
+
+   memcpy(&stats,&(desc->dev->destStats[stats.dest]),sizeof(struct DmaDestStats));
+
+   if ((ret = copy_to_user((void *)arg,&stats,sizeof(struct DmaDestStats)))) {
+      dev_warn(desc->dev->device,"Dma_GetDestStats: copy_to_user failed. ret=%i, user=%p kern=%p\n", ret, (void *)arg, &stats);
+      return(-1);
+   }
+   return(0);
+}
+
+// Get count and oldest age in uS of receive buffers held by descriptor
+uint32_t Dma_HeldAge(struct DmaDesc *desc, uint32_t *held) {
+   struct DmaDevice * dev;
+   struct DmaBuffer * buff;
+   uint64_t oldest;
+   uint32_t x;
+
+   dev    = desc->dev;
+   oldest = 0;
+   *held  = 0;
+
+   for (x=dev->rxBuffers.baseIdx; x < (dev->rxBuffers.baseIdx + dev->rxBuffers.count); x++) {
+      buff = dmaGetBufferList(&(dev->rxBuffers),x);
+
+      if ( (buff->userHas == desc) && (buff->rdTime != 0) ) {
+         (*held)++;
+         if ( (oldest == 0) || (buff->rdTime < oldest) ) oldest = buff->rdTime;
+      }
+   }
+   return((oldest == 0) ? 0 : dmaAgeUs(ktime_get_ns(),oldest));
+}
+
+// Get receive latency histograms
+int32_t Dma_GetLatency(struct DmaDesc *desc, uint64_t arg) {
+   struct DmaLatencyData lat;
+   int32_t ret;
+
+   BUILD_BUG_ON(DMA_LAT_BINS != DMA_HIST_BINS);
+
+   memcpy(lat.queueHist,desc->queueLat.bins,sizeof(lat.queueHist));
+   memcpy(lat.holdHist,desc->holdLat.bins,sizeof(lat.holdHist));
+   lat.queueMax = desc->queueLat.max;
+   lat.holdMax  = desc->holdLat.max;
+   lat.oldest   = Dma_HeldAge(desc,&(lat.held));
+
+   if ((ret = copy_to_user((void *)arg,&lat,sizeof(struct DmaLatencyData)))) {
+      dev_warn(desc->dev->device,"Dma_GetLatency: copy_to_user failed. ret=%i, user=%p kern=%p\n", ret, (void *)arg, &lat);
+      return(-1);
+   }
+   return(0);
+}
+
+// Attach descriptor as secondary reader
+int32_t Dma_SetSecondary(struct DmaDesc *desc, uint64_t arg) {
+   struct DmaSecondaryData * sec;
+   struct DmaDevice * dev;
+   unsigned long iflags;
+   int32_t ret;
+   uint32_t x;
+
+   static const uint8_t zero[DMA_MASK_SIZE] = { 0 };
+
+   dev = desc->dev;
+
+   // Can only be called once, and not for destination owner
+   if ( (desc->secIdx >= 0) || memcmp(desc->destMask,zero,DMA_MASK_SIZE) ) return(-1);
+
+   if ( (sec = (struct DmaSecondaryData *)kmalloc(sizeof(struct DmaSecondaryData),GFP_KERNEL)) == NULL ) {
+      dev_warn(dev->device,"Dma_SetSecondary: Failed to allocate secondary data.\n");
+      return(-ENOMEM);
+   }
+
+   if ((ret = copy_from_user(sec,(void *)arg,sizeof(struct DmaSecondaryData)))) {
+      dev_warn(dev->device,"Dma_SetSecondary: copy_from_user failed. ret=%i, user=%p kern=%p\n", ret, (void *)arg, sec);
+      kfree(sec);
+      return(-1);
+   }
+
+   // Make sure we can't receive data while adjusting secondary list
+   dmaSpinLockIrqSave(&dev->maskLock,&dev->maskStats,iflags);
+
+   for (x=0; x < DMA_MAX_SECONDARY; x++) {
+      if ( dev->secDesc[x] == NULL ) break;
+   }
+
+   if ( x == DMA_MAX_SECONDARY ) {
+      spin_unlock_irqrestore(&dev->maskLock,iflags);
+      dev_warn(dev->device,"Dma_SetSecondary: No free secondary slots.\n");
+      kfree(sec);
+      return(-1);
+   }
+
+   desc->secMax = (sec->maxHeld == 0) ? ((dev->rxBuffers.count / 16) + 1) : sec->maxHeld;
+   desc->secPrescale  = sec->prescale;
+   desc->secPreCount  = 0;
+   desc->secRate      = sec->rateLimit;
+   desc->secRateCount = 0;
+   desc->secRateTime  = jiffies;
+   desc->secIdx = x;
+   memcpy(desc->destMask,sec->mask,DMA_MASK_SIZE);
+   dev->secDesc[x] = desc;
+   dev->secCount++;
+
+   spin_unlock_irqrestore(&dev->maskLock,iflags);
+
+   if (dev->debug > 0) dev_info(dev->device,"Dma_SetSecondary: Attached secondary %i, max held %i, prescale %i, rate %i.\n",
+         x, desc->secMax, desc->secPrescale, desc->secRate);
+   kfree(sec);
+   return(0);
+}
+
+// Set receive filter
+// Rule count is passed in upper 16 bits of cmd, zero clears the filter
+int32_t Dma_SetFilter(struct DmaDesc *desc, uint32_t cmd, uint64_t arg) {
+   struct DmaFilterRule rules[DMA_MAX_FILTER];
+   unsigned long iflags;
+   int32_t ret;
+   uint32_t cnt;
+   uint32_t x;
+
+   cnt = (cmd >> 16) & 0xFFFF;
+
+   if ( cnt > DMA_MAX_FILTER ) {
+      dev_warn(desc->dev->device,"Dma_SetFilter: Too many rules %i, max %i.\n",cnt,DMA_MAX_FILTER);
+      return(-1);
+   }
+
+   if ( (cnt > 0) && (ret = copy_from_user(rules,(void *)arg,cnt * sizeof(struct DmaFilterRule))) ) {
+      dev_warn(desc->dev->device,"Dma_SetFilter: copy_from_user failed. ret=%i, user=%p kern=%p\n", ret, (void *)arg, rules);
+      return(-1);
+   }
+
+   for (x=0; x < cnt; x++) {
+      if ( rules[x].action > DMA_FILT_COUNT ) {
+         dev_warn(desc->dev->device,"Dma_SetFilter: Invalid action %i for rule %i.\n",rules[x].action,x);
+         return(-1);
+      }
+      rules[x].hits = 0;
+   }
+
+   // Make sure we can't receive data while adjusting filter
+   dmaSpinLockIrqSave(&desc->dev->maskLock,&desc->dev->maskStats,iflags);
+   memcpy(desc->filter,rules,cnt * sizeof(struct DmaFilterRule));
+   desc->filterCount = cnt;
+   spin_unlock_irqrestore(&desc->dev->maskLock,iflags);
+
+   return(0);
+}
+
+// Get receive filter and hit counters
+// Rule count is passed in upper 16 bits of cmd, returns number of rules
+int32_t Dma_GetFilter(struct DmaDesc *desc, uint32_t cmd, uint64_t arg) {
+   struct DmaFilterRule rules[DMA_MAX_FILTER];
+   unsigned long iflags;
+   int32_t ret;
+   uint32_t cnt;
+
+   cnt = (cmd >> 16) & 0xFFFF;
+
+   dmaSpinLockIrqSave(&desc->dev->maskLock,&desc->dev->maskStats,iflags);
+   if ( cnt > desc->filterCount ) cnt = desc->filterCount;
+   memcpy(rules,desc->filter,cnt * sizeof(struct DmaFilterRule));
+   spin_unlock_irqrestore(&desc->dev->maskLock,iflags);
+
+   if ( (cnt > 0) && (ret = copy_to_user((void *)arg,rules,cnt * sizeof(struct DmaFilterRule))) ) {
+      dev_warn(desc->dev->device,"Dma_GetFilter: copy_to_user failed. ret=%i, user=%p kern=%p\n", ret, (void *)arg, rules);
+      return(-1);
+   }
+
+   return(cnt);
+}
+
+// Release descriptor hold on a receive buffer
+// Returns 1 if the buffer has no more holders and must be returned to hardware
+uint32_t Dma_RxRelease(struct DmaDesc *desc, struct DmaBuffer *buff) {
+
+   // Secondary must hold buffer
+   if ( desc->secIdx >= 0 ) {
+      if ( ! test_and_clear_bit(desc->secIdx,&(buff->secHas)) ) return(0);
+      atomic_dec(&(desc->secHeld));
+   }
+   return(dmaBufferRelease(buff));
+}
+
+// Execute a list of register transactions
+// Returns number of transactions completed, stops at first failure
+int32_t Dma_RegisterVector(struct DmaDevice *dev, uint32_t cmd, uint64_t arg) {
+   struct DmaRegisterOp * ops;
+   uint8_t * addr;
+   uint32_t  cnt;
+   uint32_t  x;
+   int32_t   ret;
+
+   cnt = (cmd >> 16) & 0xFFFF;
+   if ( cnt == 0 ) return(0);
+
+   if ( (ops = (struct DmaRegisterOp *)kmalloc(cnt * sizeof(struct DmaRegisterOp),GFP_KERNEL)) == NULL ) {
+      dev_warn(dev->device,"Dma_RegisterVector: Failed to allocate %i transactions.\n",cnt);
+      return(-1);
+   }
+
+   if ((ret = copy_from_user(ops,(void *)arg,cnt * sizeof(struct DmaRegisterOp)))) {
+      dev_warn(dev->device,"Dma_RegisterVector: copy_from_user failed. ret=%i, user=%p kern=%p\n", ret, (void *)arg, ops);
+      kfree(ops);
+      return(-1);
+   }
+
+   for (x=0; x < cnt; x++) {
+      addr = dev->base + ops[x].address;
+
+      if ( ( addr < dev->rwBase ) || ( (addr + 4) > (dev->rwBase + dev->rwSize) ) ) break;
+      if ( dmaRegisterOp(addr,&(ops[x])) < 0 ) break;
+   }
+
+   // Return read data
+   if ((ret = copy_to_user((void *)arg,ops,cnt * sizeof(struct DmaRegisterOp)))) {
+      dev_warn(dev->device,"Dma_RegisterVector: copy_to_user failed. ret=%i, user=%p kern=%p\n", ret, (void *)arg, ops);
+      kfree(ops);
+      return(-1);
+   }
+
+   kfree(ops);
+   return(x);
+}
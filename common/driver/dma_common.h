@@ -27,15 +27,87 @@
 #include <linux/types.h>
 #include <linux/fs.h>
 #include <linux/interrupt.h>
+#include <linux/list.h>
+#include <linux/bitmap.h>
+#include <linux/version.h>
+#include <linux/jump_label.h>
+#include <linux/ktime.h>
+#include <linux/bitops.h>
+#include <linux/workqueue.h>
+#include <linux/mutex.h>
 #include <DmaDriver.h>
 #include <dma_buffer.h>
 
 // Maximum number of channels
 #define DMA_MAX_DEST (8*DMA_MASK_SIZE)
 
+// Maximum number of secondary descriptors, must fit DmaBuffer secHas
+#define DMA_MAX_SECONDARY 8
+
+// Default throughput sample interval in mS and samples shown in proc
+#define DMA_SAMPLE_DEF  1000
+#define DMA_SERIES_PROC 10
+
+// Debug trace ring entries, power of 2
+#define DMA_TRACE_SIZE 4096
+
+// Debug trace events
+#define DMA_TRACE_IRQ    1
+#define DMA_TRACE_RX     2
+#define DMA_TRACE_RX_RET 3
+#define DMA_TRACE_TX     4
+#define DMA_TRACE_READ   5
+#define DMA_TRACE_WRITE  6
+#define DMA_TRACE_INDEX  7
+
+// Device references held on global static keys, bits in keyFlags
+#define DMA_KEY_DEBUG 0
+#define DMA_KEY_LOCK  1
+
+// Histogram bins, bin 0 counts zero, bin n counts 2^(n-1) to 2^n - 1, last bin is open ended
+#define DMA_HIST_BINS 32
+
 // Forward declarations
 struct hardware_functions;
 struct DmaDesc;
+struct dentry;
+
+// Debug trace entry, seq is zero while the entry is being written
+struct DmaTraceEntry {
+   uint32_t seq;
+   uint32_t event;
+   uint64_t time;
+   uint32_t index;
+   uint32_t dest;
+   uint32_t size;
+   uint32_t flags;
+   uint32_t error;
+   uint32_t pad;
+};
+
+// Log2 histogram with maximum value
+struct DmaHist {
+   uint32_t bins[DMA_HIST_BINS];
+   uint32_t max;
+};
+
+// Per interrupt handler stats, refill counts buffers returned to the free list by the handler
+struct DmaIrqStats {
+   uint64_t       count;
+   struct DmaHist time;
+   struct DmaHist rx;
+   struct DmaHist tx;
+   struct DmaHist refill;
+};
+
+// Per frame debug checks, the static key is enabled while any device has debug set
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,3,0)
+DECLARE_STATIC_KEY_FALSE(DmaDebugKey);
+#define dmaDebug(dev) (static_branch_unlikely(&DmaDebugKey) && ((dev)->debug > 0))
+#else
+extern struct static_key DmaDebugKey;
+#define dmaDebug(dev) (static_key_false(&DmaDebugKey) && ((dev)->debug > 0))
+#endif
 
 // Device structure
 struct DmaDevice {
@@ -60,6 +132,12 @@ struct DmaDevice {
    uint32_t cfgRxCount;
    uint32_t cfgMode;
    uint32_t cfgCont;
+   uint32_t cfgIrqBudget;
+   uint32_t cfgEngines;
+   uint32_t cfgDescPost;
+   uint32_t cfgTxLazy;
+   uint32_t cfgDrop;
+   uint32_t cfgSample;
 
    // Device tracking
    uint32_t        index;
@@ -77,6 +155,9 @@ struct DmaDevice {
    // Debug flag
    uint8_t debug;
 
+   // Static key references held by device, changed with atomic bit ops
+   unsigned long keyFlags;
+
    // IRQ
    uint32_t irq;
 
@@ -84,16 +165,52 @@ struct DmaDevice {
    spinlock_t writeHwLock;
    spinlock_t commandLock;
    spinlock_t maskLock;
+   spinlock_t descLock;
+
+   // Lock contention, recorded while DMA_KEY_LOCK is set in keyFlags
+   struct DmaLockStats writeHwStats;
+   struct DmaLockStats commandStats;
+   struct DmaLockStats maskStats;
+   struct DmaLockStats descStats;
 
    // Owners
    struct DmaDesc * desc[DMA_MAX_DEST];
 
+   // Secondary readers, protected by maskLock
+   struct DmaDesc * secDesc[DMA_MAX_SECONDARY];
+   uint32_t         secCount;
+
+   // Open descriptors, protected by descLock
+   struct list_head descList;
+
+   // Per destination traffic and drop counters, mapped read only to user space
+   // Each dest is updated by a single completion path, no locking
+   struct DmaDestStats * destStats;
+
    // Transmit/receive buffer list
    struct DmaBufferList txBuffers;
    struct DmaBufferList rxBuffers;
 
    // Transmit queue
    struct DmaQueue tq;
+
+   // Interrupt handler histograms, updated by the handler under irqStatsLock
+   struct DmaIrqStats irqStats;
+   spinlock_t         irqStatsLock;
+
+   // Debug trace ring, one in traceSample events is recorded
+   struct DmaTraceEntry * trace;
+   atomic_t               traceHead;
+   atomic_t               traceCount;
+   uint32_t               traceSample;
+   struct dentry        * traceDir;
+
+   // Throughput time series, sampled from destStats every cfgSample mS
+   struct DmaSample     * series;
+   struct DmaSample       seriesTot;
+   uint64_t               seriesSeq;
+   struct mutex           seriesLock;
+   struct delayed_work    seriesWork;
 };
 
 // File descriptor struct
@@ -102,9 +219,43 @@ struct DmaDesc {
    // Mask of destinations
    uint8_t destMask[DMA_MASK_SIZE];
 
+   // Owned destinations as bitmap, protected by maskLock
+   DECLARE_BITMAP(destBits,DMA_MAX_DEST);
+
    // Receive queue
    struct DmaQueue q;
 
+   // Receive queue overflow mode and depth
+   uint32_t ovfMode;
+   uint32_t ovfDepth;
+   uint32_t dropCount;
+
+   // Secondary reader slot, -1 for primary, and held buffer limit
+   int32_t  secIdx;
+   uint32_t secMax;
+   atomic_t secHeld;
+
+   // Receive filter, protected by maskLock
+   struct DmaFilterRule filter[DMA_MAX_FILTER];
+   uint32_t             filterCount;
+
+   // Receive queue residency and index hold time, uS
+   struct DmaHist queueLat;
+   struct DmaHist holdLat;
+
+   // Secondary sampling, prescale and rate limit in frames per second
+   uint32_t      secPrescale;
+   uint32_t      secPreCount;
+   uint32_t      secRate;
+   uint32_t      secRateCount;
+   unsigned long secRateTime;
+
+   // Process which opened the descriptor
+   pid_t pid;
+
+   // Entry in device descriptor list
+   struct list_head list;
+
    // Async queue
    struct fasync_struct *async_queue;   
 
@@ -115,6 +266,7 @@ struct DmaDesc {
 // Hardware Functions
 struct hardware_functions {
    irqreturn_t (*irq)(int irq, void *dev_id);
+   irqreturn_t (*irqThread)(int irq, void *dev_id);
    void        (*init)(struct DmaDevice *dev);
    void        (*enable)(struct DmaDevice *dev);
    void        (*clear)(struct DmaDevice *dev);
@@ -122,6 +274,7 @@ struct hardware_functions {
    int32_t     (*sendBuffer)(struct DmaDevice *dev, struct DmaBuffer **buff, uint32_t count);
    int32_t     (*command)(struct DmaDevice *dev, uint32_t cmd, uint64_t arg);
    void        (*seqShow)(struct seq_file *s, struct DmaDevice *dev);
+   void        (*txReap)(struct DmaDevice *dev);
 };
 
 // Global array of devices
@@ -183,6 +336,105 @@ int Dma_Mmap(struct file *filp, struct vm_area_struct *vma);
 // Flush queue
 int Dma_Fasync(int fd, struct file *filp, int mode);
 
+// Add value to histogram
+static inline void dmaHistAdd(struct DmaHist *hist, uint32_t val) {
+   uint32_t bin;
+
+   bin = fls(val);
+   if ( bin >= DMA_HIST_BINS ) bin = DMA_HIST_BINS-1;
+   hist->bins[bin]++;
+   if ( val > hist->max ) hist->max = val;
+}
+
+// Record cost and batch sizes of one interrupt, start is ktime_get_ns() at handler entry
+static inline void dmaIrqRecord(struct DmaDevice *dev, uint64_t start, uint32_t rx, uint32_t tx, uint32_t refill) {
+   unsigned long iflags;
+   uint64_t dur;
+
+   dur = ktime_get_ns() - start;
+
+   // Handler and irq thread both record, lock is uncontended outside of reset
+   spin_lock_irqsave(&(dev->irqStatsLock),iflags);
+   dev->irqStats.count++;
+   dmaHistAdd(&(dev->irqStats.time),(dur > 0xFFFFFFFF) ? 0xFFFFFFFF : (uint32_t)dur);
+   dmaHistAdd(&(dev->irqStats.rx),rx);
+   dmaHistAdd(&(dev->irqStats.tx),tx);
+   dmaHistAdd(&(dev->irqStats.refill),refill);
+   spin_unlock_irqrestore(&(dev->irqStatsLock),iflags);
+}
+
+// Count received frame in destination counters
+static inline void dmaDestRx(struct DmaDevice *dev, struct DmaBuffer *buff) {
+   struct DmaDestStats * st;
+   uint32_t bin;
+   uint32_t x;
+
+   if ( buff->dest >= DMA_MAX_DEST ) return;
+   st = &(dev->destStats[buff->dest]);
+
+   st->rxFrames++;
+   st->rxBytes += buff->size;
+
+   if ( buff->error != 0 ) {
+      st->rxErrors++;
+      for (x=0; x < DMA_STATS_ERR_BITS; x++)
+         if ( buff->error & (1 << x) ) st->errBits[x]++;
+   }
+
+   bin = fls(buff->size);
+   if ( bin >= DMA_STATS_BINS ) bin = DMA_STATS_BINS-1;
+   st->sizeHist[bin]++;
+}
+
+// Count completed transmit frame in destination counters
+static inline void dmaDestTx(struct DmaDevice *dev, struct DmaBuffer *buff) {
+   if ( buff->dest >= DMA_MAX_DEST ) return;
+   dev->destStats[buff->dest].txFrames++;
+   dev->destStats[buff->dest].txBytes += buff->size;
+}
+
+// Age of a timestamp in uS, saturated
+static inline uint32_t dmaAgeUs(uint64_t now, uint64_t time) {
+   uint64_t age;
+
+   age = div_u64(now - time,1000);
+   return((age > 0xFFFFFFFF) ? 0xFFFFFFFF : (uint32_t)age);
+}
+
+// Record index hold time when a buffer read by index is returned by its holder
+static inline void dmaHoldDone(struct DmaDesc *desc, struct DmaBuffer *buff) {
+   if ( buff->rdTime == 0 ) return;
+   dmaHistAdd(&(desc->holdLat),dmaAgeUs(ktime_get_ns(),buff->rdTime));
+   buff->rdTime = 0;
+}
+
+// Show histogram in proc file
+void Dma_HistShow(struct seq_file *s, const char *name, struct DmaHist *hist);
+
+// Take throughput sample
+void Dma_SeriesWork(struct work_struct *work);
+
+// Get throughput time series
+int32_t Dma_GetSeries(struct DmaDevice *dev, uint64_t arg);
+
+// Show lock contention in proc file
+void Dma_LockShow(struct seq_file *s, const char *name, struct DmaLockStats *st);
+
+// Enable or disable lock contention statistics
+void Dma_SetLockStats(struct DmaDevice *dev, uint32_t enable);
+
+// Set debug level and trace sampling
+void Dma_SetDebug(struct DmaDevice *dev, uint32_t arg);
+
+// Record debug trace entry
+void Dma_Trace(struct DmaDevice *dev, uint32_t event, uint32_t index, uint32_t dest, uint32_t size, uint32_t flags, uint32_t error);
+
+// Open debugfs trace file
+int Dma_TraceOpen(struct inode *inode, struct file *file);
+
+// Show debugfs trace file
+int Dma_TraceShow(struct seq_file *s, void *v);
+
 // Open proc file
 int Dma_ProcOpen(struct inode *inode, struct file *file);
 
@@ -201,11 +453,52 @@ int Dma_SeqShow(struct seq_file *s, void *v);
 // Set Mask
 int Dma_SetMaskBytes(struct DmaDevice *dev, struct DmaDesc *desc, uint8_t * mask );
 
+// Add destination
+int32_t Dma_AddDest(struct DmaDesc *desc, uint32_t dest);
+
+// Remove destination
+int32_t Dma_RemDest(struct DmaDesc *desc, uint32_t dest);
+
+// Take destination and queued frames from current owner
+int32_t Dma_TakeDest(struct DmaDesc *desc, uint32_t dest);
+
 // Write Register
 int32_t Dma_WriteRegister(struct DmaDevice *dev, uint64_t arg);
 
 // Read Register
 int32_t Dma_ReadRegister(struct DmaDevice *dev, uint64_t arg);
 
+// Set receive queue overflow mode
+int32_t Dma_SetOverflow(struct DmaDesc *desc, uint64_t arg);
+
+// Get drop counters
+int32_t Dma_GetDrops(struct DmaDesc *desc, uint64_t arg);
+
+// Get destination traffic counters
+int32_t Dma_GetDestStats(struct DmaDesc *desc, uint64_t arg);
+
+// Get count and oldest age in uS of receive buffers held by descriptor
+uint32_t Dma_HeldAge(struct DmaDesc *desc, uint32_t *held);
+
+// Get receive latency histograms
+int32_t Dma_GetLatency(struct DmaDesc *desc, uint64_t arg);
+
+// Attach descriptor as secondary reader
+int32_t Dma_SetSecondary(struct DmaDesc *desc, uint64_t arg);
+
+// Set receive filter
+int32_t Dma_SetFilter(struct DmaDesc *desc, uint32_t cmd, uint64_t arg);
+
+// Get receive filter and hit counters
+int32_t Dma_GetFilter(struct DmaDesc *desc, uint32_t cmd, uint64_t arg);
+
+// Release descriptor hold on a receive buffer
+// Returns 1 if the buffer has no more holders and must be returned to hardware
+uint32_t Dma_RxRelease(struct DmaDesc *desc, struct DmaBuffer *buff);
+
+
+// Execute a list of register transactions
+int32_t Dma_RegisterVector(struct DmaDevice *dev, uint32_t cmd, uint64_t arg);
+
 #endif
 
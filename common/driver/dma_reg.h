@@ -0,0 +1,71 @@
+/**
+ *-----------------------------------------------------------------------------
+ * Title      : Register transactions
+ * ----------------------------------------------------------------------------
+ * File       : dma_reg.h
+ * Created    : 2017-03-24
+ * ----------------------------------------------------------------------------
+ * Description:
+ * Single register transaction shared by the DMA and memory map drivers.
+ * ----------------------------------------------------------------------------
+ * This file is part of the aes_stream_drivers package. It is subject to
+ * the license terms in the LICENSE.txt file found in the top-level directory
+ * of this distribution and at:
+ *    https://confluence.slac.stanford.edu/display/ppareg/LICENSE.html.
+ * No part of the aes_stream_drivers package, including this file, may be
+ * copied, modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE.txt file.
+ * ----------------------------------------------------------------------------
+**/
+#ifndef __DMA_REG_H__
+#define __DMA_REG_H__
+
+#include <linux/types.h>
+#include <linux/io.h>
+#include <linux/jiffies.h>
+#include <linux/delay.h>
+#include <linux/sched.h>
+#include <DmaDriver.h>
+
+// Longest register poll and sleep between poll reads, uS
+#define DMA_REG_POLL_MAX   1000000
+#define DMA_REG_POLL_SLEEP 10
+
+// Execute single register transaction, polls sleep so process context only
+// Return -1 on poll timeout or signal
+static inline int32_t dmaRegisterOp(uint8_t *addr, struct DmaRegisterOp *op) {
+   unsigned long stop;
+   uint32_t timeout;
+
+   switch (op->op) {
+
+      case DMA_REG_READ:
+         op->rdData = ioread32(addr);
+         break;
+
+      case DMA_REG_WRITE:
+         iowrite32(op->data,addr);
+         break;
+
+      case DMA_REG_RMW:
+         op->rdData = (ioread32(addr) & ~(op->mask)) | (op->data & op->mask);
+         iowrite32(op->rdData,addr);
+         break;
+
+      case DMA_REG_POLL:
+         timeout = (op->timeout > DMA_REG_POLL_MAX) ? DMA_REG_POLL_MAX : op->timeout;
+         stop = jiffies + usecs_to_jiffies(timeout) + 1;
+         while ( ((op->rdData = ioread32(addr)) & op->mask) != op->data ) {
+            if ( time_after(jiffies,stop) || signal_pending(current) ) return(-1);
+            usleep_range(DMA_REG_POLL_SLEEP,DMA_REG_POLL_SLEEP*2);
+         }
+         break;
+
+      default:
+         return(-1);
+         break;
+   }
+   return(0);
+}
+
+#endif
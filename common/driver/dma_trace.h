@@ -0,0 +1,108 @@
+/**
+ *-----------------------------------------------------------------------------
+ * Title      : DMA buffer lifecycle tracepoints
+ * ----------------------------------------------------------------------------
+ * File       : dma_trace.h
+ * Created    : 2017-03-24
+ * ----------------------------------------------------------------------------
+ * Description:
+ * Ftrace events for buffers moving between hardware, receive queues and user
+ * space. Events are under the aes_dma system, e.g.
+ * trace-cmd record -e aes_dma. Each event carries the device index, buffer
+ * index, dest, size, flags and error at the point it fires.
+ * ----------------------------------------------------------------------------
+ * This file is part of the aes_stream_drivers package. It is subject to 
+ * the license terms in the LICENSE.txt file found in the top-level directory 
+ * of this distribution and at: 
+ *    https://confluence.slac.stanford.edu/display/ppareg/LICENSE.html. 
+ * No part of the aes_stream_drivers package, including this file, may be 
+ * copied, modified, propagated, or distributed except according to the terms 
+ * contained in the LICENSE.txt file.
+ * ----------------------------------------------------------------------------
+**/
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM aes_dma
+
+#if !defined(__DMA_TRACE_H__) || defined(TRACE_HEADER_MULTI_READ)
+#define __DMA_TRACE_H__
+
+#include <linux/tracepoint.h>
+#include <dma_buffer.h>
+#include <dma_common.h>
+
+DECLARE_EVENT_CLASS(dma_buffer_class,
+   TP_PROTO(struct DmaBuffer *buff),
+   TP_ARGS(buff),
+
+   TP_STRUCT__entry(
+      __field(uint32_t, dev)
+      __field(uint32_t, index)
+      __field(uint32_t, dest)
+      __field(uint32_t, size)
+      __field(uint32_t, flags)
+      __field(uint32_t, error)
+   ),
+
+   TP_fast_assign(
+      __entry->dev   = buff->buffList->dev->index;
+      __entry->index = buff->index;
+      __entry->dest  = buff->dest;
+      __entry->size  = buff->size;
+      __entry->flags = buff->flags;
+      __entry->error = buff->error;
+   ),
+
+   TP_printk("dev=%u index=%u dest=%u size=%u flags=0x%x error=0x%x",
+      __entry->dev, __entry->index, __entry->dest, __entry->size, __entry->flags, __entry->error)
+);
+
+// Buffer posted to hardware
+DEFINE_EVENT(dma_buffer_class, dma_post_hw,
+   TP_PROTO(struct DmaBuffer *buff),
+   TP_ARGS(buff)
+);
+
+// Receive completion, before delivery
+DEFINE_EVENT(dma_buffer_class, dma_rx_done,
+   TP_PROTO(struct DmaBuffer *buff),
+   TP_ARGS(buff)
+);
+
+// Receive buffer queued to descriptor
+DEFINE_EVENT(dma_buffer_class, dma_rx_queue,
+   TP_PROTO(struct DmaBuffer *buff),
+   TP_ARGS(buff)
+);
+
+// Receive buffer dequeued by read
+DEFINE_EVENT(dma_buffer_class, dma_read,
+   TP_PROTO(struct DmaBuffer *buff),
+   TP_ARGS(buff)
+);
+
+// Buffer index returned by user
+DEFINE_EVENT(dma_buffer_class, dma_ret_index,
+   TP_PROTO(struct DmaBuffer *buff),
+   TP_ARGS(buff)
+);
+
+// Transmit submitted by write
+DEFINE_EVENT(dma_buffer_class, dma_tx_submit,
+   TP_PROTO(struct DmaBuffer *buff),
+   TP_ARGS(buff)
+);
+
+// Transmit completion
+DEFINE_EVENT(dma_buffer_class, dma_tx_done,
+   TP_PROTO(struct DmaBuffer *buff),
+   TP_ARGS(buff)
+);
+
+#endif
+
+// Must be outside of header guard, file is found through the driver include path
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE dma_trace
+#include <trace/define_trace.h>
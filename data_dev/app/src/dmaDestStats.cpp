@@ -0,0 +1,112 @@
+/**
+ *-----------------------------------------------------------------------------
+ * Title      : Destination traffic monitor
+ * ----------------------------------------------------------------------------
+ * File       : dmaDestStats.cpp
+ * Created    : 2017-03-24
+ * ----------------------------------------------------------------------------
+ * Description:
+ * This program samples the mapped per destination counters and prints rates.
+ * ----------------------------------------------------------------------------
+ * This file is part of the aes_stream_drivers package. It is subject to
+ * the license terms in the LICENSE.txt file found in the top-level directory
+ * of this distribution and at:
+    * https://confluence.slac.stanford.edu/display/ppareg/LICENSE.html.
+ * No part of the aes_stream_drivers package, including this file, may be
+ * copied, modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE.txt file.
+ * ----------------------------------------------------------------------------
+**/
+#include <sys/types.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <string.h>
+#include <argp.h>
+#include <stdlib.h>
+#include <DmaDriver.h>
+using namespace std;
+
+const  char * argp_program_version = "dmaDestStats 1.0";
+const  char * argp_program_bug_address = "rherbst@slac.stanford.edu";
+
+struct PrgArgs {
+   const char * path;
+   uint32_t     period;
+   uint32_t     count;
+};
+
+static struct PrgArgs DefArgs = { "/dev/datadev_0", 100, 0 };
+
+static char   args_doc[] = "";
+static char   doc[]      = "";
+
+static struct argp_option options[] = {
+   { "path",   'p', "PATH",   OPTION_ARG_OPTIONAL, "Path of datadev device to use. Default=/dev/datadev_0.",0},
+   { "period", 't', "PERIOD", OPTION_ARG_OPTIONAL, "Sample period in mS. Default=100.",0},
+   { "count",  'c', "COUNT",  OPTION_ARG_OPTIONAL, "Number of samples, 0 = forever. Default=0.",0},
+   {0}
+};
+
+error_t parseArgs ( int key,  char *arg, struct argp_state *state ) {
+   struct PrgArgs *args = (struct PrgArgs *)state->input;
+
+   switch(key) {
+      case 'p': args->path = arg; break;
+      case 't': args->period = strtol(arg,NULL,10); break;
+      case 'c': args->count = strtol(arg,NULL,10); break;
+      default: return ARGP_ERR_UNKNOWN; break;
+   }
+   return(0);
+}
+
+static struct argp argp = {options,parseArgs,args_doc,doc};
+
+int main (int argc, char **argv) {
+   const struct DmaDestStats * stats;
+   struct DmaDestStats * last;
+   struct PrgArgs args;
+   double   secs;
+   uint32_t x;
+   uint32_t n;
+   int s;
+
+   memcpy(&args,&DefArgs,sizeof(struct PrgArgs));
+   argp_parse(&argp,argc,argv,0,0,&args);
+
+   if ( (s = open(args.path, O_RDONLY)) <= 0 ) {
+      printf("Error opening %s\n",args.path);
+      return(1);
+   }
+
+   if ( (stats = dmaMapDestStats(s)) == NULL ) {
+      printf("Failed to map destination counters\n");
+      close(s);
+      return(1);
+   }
+
+   last = (struct DmaDestStats *)malloc(DMA_STATS_COUNT * sizeof(struct DmaDestStats));
+   memcpy(last,stats,DMA_STATS_COUNT * sizeof(struct DmaDestStats));
+   secs = (double)args.period / 1000.0;
+
+   for (n=0; (args.count == 0) || (n < args.count); n++) {
+      usleep(args.period * 1000);
+
+      for (x=0; x < DMA_STATS_COUNT; x++) {
+         if ( (stats[x].rxFrames == last[x].rxFrames) && (stats[x].txFrames == last[x].txFrames) ) continue;
+
+         printf("Dest %4u : Rx %10.1f Hz %12.1f B/s, Tx %10.1f Hz %12.1f B/s, Errors %u, Drops %u\n",x,
+               (double)(stats[x].rxFrames - last[x].rxFrames) / secs,
+               (double)(stats[x].rxBytes  - last[x].rxBytes)  / secs,
+               (double)(stats[x].txFrames - last[x].txFrames) / secs,
+               (double)(stats[x].txBytes  - last[x].txBytes)  / secs,
+               stats[x].rxErrors, stats[x].ovfDrops + stats[x].idleDrops);
+      }
+      memcpy(last,stats,DMA_STATS_COUNT * sizeof(struct DmaDestStats));
+   }
+
+   free(last);
+   dmaUnMapDestStats(stats);
+   close(s);
+   return(0);
+}
@@ -0,0 +1,96 @@
+/**
+ *-----------------------------------------------------------------------------
+ * Title      : Descriptor posting benchmark
+ * ----------------------------------------------------------------------------
+ * File       : dmaPostBench.cpp
+ * Created    : 2017-03-24
+ * ----------------------------------------------------------------------------
+ * Description:
+ * This program times descriptor posting register writes in the driver.
+ * ----------------------------------------------------------------------------
+ * This file is part of the aes_stream_drivers package. It is subject to
+ * the license terms in the LICENSE.txt file found in the top-level directory
+ * of this distribution and at:
+    * https://confluence.slac.stanford.edu/display/ppareg/LICENSE.html.
+ * No part of the aes_stream_drivers package, including this file, may be
+ * copied, modified, propagated, or distributed except according to the terms
+ * contained in the LICENSE.txt file.
+ * ----------------------------------------------------------------------------
+**/
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <string.h>
+#include <argp.h>
+#include <stdlib.h>
+#include <AxisDriver.h>
+using namespace std;
+
+const  char * argp_program_version = "dmaPostBench 1.0";
+const  char * argp_program_bug_address = "rherbst@slac.stanford.edu";
+
+struct PrgArgs {
+   const char * path;
+   uint32_t     count;
+};
+
+static struct PrgArgs DefArgs = { "/dev/datadev_0", 100000 };
+
+static char   args_doc[] = "";
+static char   doc[]      = "";
+
+static struct argp_option options[] = {
+   { "path",  'p', "PATH",  OPTION_ARG_OPTIONAL, "Path of datadev device to use. Default=/dev/datadev_0.",0},
+   { "count", 'c', "COUNT", OPTION_ARG_OPTIONAL, "Number of descriptors to post per mode. Default=100000.",0},
+   {0}
+};
+
+error_t parseArgs ( int key,  char *arg, struct argp_state *state ) {
+   struct PrgArgs *args = (struct PrgArgs *)state->input;
+
+   switch(key) {
+      case 'p': args->path = arg; break;
+      case 'c': args->count = strtol(arg,NULL,10); break;
+      default: return ARGP_ERR_UNKNOWN; break;
+   }
+   return(0);
+}
+
+static struct argp argp = {options,parseArgs,args_doc,doc};
+
+// Print result for a posting mode
+void showResult ( const char *name, uint64_t ns, uint32_t count ) {
+   if ( ns == 0 ) printf("%20s : not supported\n",name);
+   else printf("%20s : %llu nS total, %.1f nS per descriptor\n",name,(unsigned long long)ns,(double)ns / (double)count);
+}
+
+int main (int argc, char **argv) {
+   struct AxisPostBench bench;
+   struct PrgArgs args;
+   int s;
+
+   memcpy(&args,&DefArgs,sizeof(struct PrgArgs));
+   argp_parse(&argp,argc,argv,0,0,&args);
+
+   if ( (s = open(args.path, O_RDWR)) <= 0 ) {
+      printf("Error opening %s\n",args.path);
+      return(1);
+   }
+
+   if ( axisPostBench(s,args.count,&bench) < 0 ) {
+      printf("Benchmark failed, device must be idle with no other readers\n");
+      close(s);
+      return(1);
+   }
+
+   printf("Posted %i descriptors per mode\n",bench.count);
+   showResult("4 x 32-bit",bench.narrowNs,bench.count);
+   showResult("2 x 64-bit",bench.wideNs,bench.count);
+   showResult("Address table",bench.tableNs,bench.count);
+   showResult("Address table WC",bench.tableWcNs,bench.count);
+
+   close(s);
+   return(0);
+}
@@ -29,6 +29,10 @@
 #include <linux/seq_file.h>
 #include <linux/signal.h>
 #include <linux/pci.h>
+#include <linux/interrupt.h>
+#include <linux/cpumask.h>
+#include <linux/numa.h>
+#include <linux/version.h>
 #include <axis_gen2.h>
 
 // Init Configuration values
@@ -37,6 +41,14 @@ int cfgRxCount = 8192;
 int cfgSize    = 327680;
 int cfgMode    = BUFF_COHERENT;
 int cfgCont    = 1;
+int cfgIrqBudget = 0;
+int cfgIrqMsi    = 1;
+int cfgIrqCpu    = -1;
+int cfgEngines   = 1;
+int cfgDescPost  = 0;
+int cfgTxLazy    = 0;
+int cfgDrop      = 0;
+int cfgSample    = 1000;
 
 struct DmaDevice gDmaDevices[MAX_DMA_DEVICES];
 
@@ -91,9 +103,11 @@ int DataDev_Probe(struct pci_dev *pcidev, const struct pci_device_id *dev_id) {
    struct DmaDevice *dev;
    struct pci_device_id *id;
    struct hardware_functions *hfunc;
+   const struct cpumask *mask;
 
    int32_t x;
    int32_t dummy;
+   int32_t node;
 
    if ( cfgMode != BUFF_COHERENT && cfgMode != BUFF_STREAM ) {
       pr_warning("%s: Probe: Invalid buffer mode = %i.\n",MOD_NAME,cfgMode);
@@ -146,9 +160,28 @@ int DataDev_Probe(struct pci_dev *pcidev, const struct pci_device_id *dev_id) {
    dev->cfgSize    = cfgSize;
    dev->cfgMode    = cfgMode;
    dev->cfgCont    = cfgCont;
+   dev->cfgIrqBudget = cfgIrqBudget;
+   dev->cfgEngines   = cfgEngines;
+   dev->cfgDescPost  = cfgDescPost;
+   dev->cfgTxLazy    = cfgTxLazy;
+   dev->cfgDrop      = cfgDrop;
+   dev->cfgSample    = cfgSample;
+
+   // Get IRQ, firmware raises a single interrupt for both rings.
+   // Prefer MSI-X then MSI, falling back to the legacy line.
+   if ( cfgIrqMsi ) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,8,0)
+      if ( pci_alloc_irq_vectors(pcidev,1,1,PCI_IRQ_ALL_TYPES) == 1 ) dev->irq = pci_irq_vector(pcidev,0);
+      else dev->irq = pcidev->irq;
+#else
+      if ( pci_enable_msi(pcidev) < 0 ) pr_warning("%s: Probe: Failed to enable MSI.\n",MOD_NAME);
+      dev->irq = pcidev->irq;
+#endif
+   }
+   else dev->irq = pcidev->irq;
 
-   // Get IRQ from pci_dev structure. 
-   dev->irq = pcidev->irq;
+   pr_info("%s: Probe: Using %s interrupt %i.\n",MOD_NAME,
+         pcidev->msix_enabled ? "MSI-X" : (pcidev->msi_enabled ? "MSI" : "legacy"),dev->irq);
 
    // Set device fields
    dev->device = &(pcidev->dev);
@@ -178,6 +211,22 @@ int DataDev_Probe(struct pci_dev *pcidev, const struct pci_device_id *dev_id) {
    // Call common dma init function
    if ( Dma_Init(dev) < 0 ) return(-1);
 
+   // Hint interrupt placement on selected cpu or the card's NUMA node
+   if ( dev->irq != 0 ) {
+      node = dev_to_node(dev->device);
+      mask = NULL;
+
+      if ( (cfgIrqCpu >= 0) && (cfgIrqCpu < nr_cpu_ids) && cpu_online(cfgIrqCpu) ) mask = cpumask_of(cfgIrqCpu);
+      else if ( node != NUMA_NO_NODE ) mask = cpumask_of_node(node);
+
+      if ( mask != NULL ) {
+         if ( irq_set_affinity_hint(dev->irq,mask) == 0 )
+            dev_info(dev->device,"Init: IRQ %i affinity hint set to cpus %*pbl.\n",dev->irq,cpumask_pr_args(mask));
+         else
+            dev_warn(dev->device,"Init: Failed to set IRQ %i affinity hint.\n",dev->irq);
+      }
+   }
+
    dev_info(dev->device,"Init: Reg  space mapped to 0x%llx.\n",(uint64_t)dev->reg);
    dev_info(dev->device,"Init: User space mapped to 0x%llx with size 0x%x.\n",(uint64_t)dev->rwBase,dev->rwSize);
    dev_info(dev->device,"Init: Top Register = 0x%x\n",ioread32(dev->reg));
@@ -215,6 +264,13 @@ void  DataDev_Remove(struct pci_dev *pcidev) {
 
    // Call common dma init function
    Dma_Clean(dev);
+
+   // Release MSI vectors, no effect for legacy interrupt
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,8,0)
+   pci_free_irq_vectors(pcidev);
+#else
+   pci_disable_msi(pcidev);
+#endif
    pr_info("%s: Remove: Driver is unloaded.\n",MOD_NAME);
 }
 
@@ -245,6 +301,7 @@ void DataDev_SeqShow(struct seq_file *s, struct DmaDevice *dev) {
 // Set functions
 struct hardware_functions DataDev_functions = {
    .irq          = AxisG2_Irq,
+   .irqThread    = AxisG2_IrqThread,
    .init         = AxisG2_Init,
    .clear        = AxisG2_Clear,
    .enable       = AxisG2_Enable,
@@ -270,3 +327,27 @@ MODULE_PARM_DESC(cfgMode, "RX buffer mode");
 module_param(cfgCont,int,0);
 MODULE_PARM_DESC(cfgCont, "RX continue enable");
 
+module_param(cfgIrqBudget,int,0);
+MODULE_PARM_DESC(cfgIrqBudget, "Threaded IRQ ring budget, 0 to process rings in hard IRQ");
+
+module_param(cfgIrqMsi,int,0);
+MODULE_PARM_DESC(cfgIrqMsi, "Use MSI-X or MSI interrupt when available, 0 for legacy");
+
+module_param(cfgIrqCpu,int,0);
+MODULE_PARM_DESC(cfgIrqCpu, "IRQ affinity hint cpu, -1 for the card's NUMA node");
+
+module_param(cfgEngines,int,0);
+MODULE_PARM_DESC(cfgEngines, "Number of DMA engines in firmware, values above 1 are refused until firmware reports engine locations");
+
+module_param(cfgDescPost,int,0);
+MODULE_PARM_DESC(cfgDescPost, "Descriptor posting, bit 0 = 64-bit FIFO writes, bit 1 = write combined address table");
+
+module_param(cfgTxLazy,int,0);
+MODULE_PARM_DESC(cfgTxLazy, "Lazy TX completion reclaim low water mark in TX buffers, 0 to reclaim in IRQ");
+
+module_param(cfgDrop,int,0);
+MODULE_PARM_DESC(cfgDrop, "RX hardware drop enable, firmware drops frames when no free buffer is posted");
+
+module_param(cfgSample,int,0);
+MODULE_PARM_DESC(cfgSample, "Throughput time series sample interval in mS");
+
@@ -0,0 +1 @@
+../../../common/driver/dma_reg.h
\ No newline at end of file
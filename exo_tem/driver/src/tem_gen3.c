@@ -46,8 +46,11 @@ irqreturn_t TemG3_Irq(int irq, void *dev_id) {
    uint32_t    dmaId;
    uint32_t    subId;
    irqreturn_t ret;
+   uint32_t    rxCount;
+   uint32_t    txCount;
+   uint32_t    refill;
+   uint64_t    start;
 
-   struct DmaDesc      * desc;
    struct DmaBuffer    * buff;
    struct DmaDevice    * dev;
    struct TemG3Reg * reg;
@@ -62,7 +65,10 @@ irqreturn_t TemG3_Irq(int irq, void *dev_id) {
    // Is this the source
    if ( (stat & 0x2) != 0 ) {
 
-      if ( dev->debug > 0 ) dev_info(dev->device,"Irq: IRQ Called.\n");
+      start   = ktime_get_ns();
+      rxCount = 0;
+      txCount = 0;
+      refill  = 0;
 
       // Disable interrupts
       iowrite32(0,&(reg->irq));
@@ -82,12 +88,14 @@ irqreturn_t TemG3_Irq(int irq, void *dev_id) {
 
             if ( (stat & 0x1) == 0x1 ) {
 
-               if ( dev->debug > 0 ) 
-                  dev_info(dev->device,"Irq: Return TX Status Value %.8x.\n",stat);
+               if ( dmaDebug(dev) ) Dma_Trace(dev,DMA_TRACE_TX,stat,0,0,0,0);
+
+               txCount++;
 
                // Attempt to find buffer in tx pool and return. otherwise return rx entry to hw.
                if ((buff = dmaRetBufferIrq (dev,stat&0xFFFFFFFC)) != NULL) {
                   iowrite32((stat & 0xFFFFFFFC), &(reg->rxFree[buff->owner]));
+                  refill++;
                }
             }
 
@@ -116,6 +124,7 @@ irqreturn_t TemG3_Irq(int irq, void *dev_id) {
 
                   // Extract data from descriptor
                   buff->count++;
+                  rxCount++;
                   buff->flags = (descA >> 29) & 0x1; // Bit  29 (CONT)
                   dmaId       = (descA >> 26) & 0x7; // Bits 28:26
                   subId       = (descA >> 24) & 0x3; // Bits 25:24
@@ -132,30 +141,21 @@ irqreturn_t TemG3_Irq(int irq, void *dev_id) {
                   // Bit 1 of descB is the or of all errors, determine len error if others are not set
                   if (( (descB >>  1) & 0x1) && (buff->error == 0) ) buff->error |= DMA_ERR_LEN;
 
-                  if ( dev->debug > 0 ) {
-                     dev_info(dev->device,"Irq: Rx Bytes=%i, Dest=%x, Error=0x%x, Cont=%i.\n",
-                        buff->size, buff->dest, buff->error, buff->flags);
-                  }
+                  if ( dmaDebug(dev) ) Dma_Trace(dev,DMA_TRACE_RX,buff->index,buff->dest,buff->size,buff->flags,buff->error);
 
                   // Lock mask records
                   // This ensures close does not occur while irq routine is 
                   // pushing data to desc rx queue
-                  spin_lock(&dev->maskLock);
-
-                  // Find owner of lane/vc
-                  desc = dev->desc[buff->dest];
-
-                  // Return entry to FPGA if lane/vc is not open
-                  if ( desc == NULL ) {
-                     if ( dev->debug > 0 ) {
-                        dev_info(dev->device,"Irq: Port not open return to free list.\n");
-                     }
-                     iowrite32((descB & 0xFFFFFFFC), &(reg->rxFree[(descA >> 26) & 0x7]));
+                  dmaSpinLock(&dev->maskLock,&dev->maskStats);
+
+                  // Deliver to owner of lane/vc and secondary readers
+                  // Return entry to FPGA if lane/vc is not open or frame was dropped
+                  if ( (buff = dmaRxDeliverIrq(dev,buff)) != NULL ) {
+                     if ( dmaDebug(dev) ) Dma_Trace(dev,DMA_TRACE_RX_RET,buff->index,buff->dest,buff->size,0,0);
+                     iowrite32(buff->buffHandle, &(reg->rxFree[buff->owner]));
+                     refill++;
                   }
 
-                  // lane/vc is open, Add to RX Queue
-                  else dmaRxBuffer(desc,buff);
-
                   // Unlock
                   spin_unlock(&dev->maskLock);
                } 
@@ -169,9 +169,10 @@ irqreturn_t TemG3_Irq(int irq, void *dev_id) {
          } while ( (descB & 0x1) == 0x1 );
       }
 
+      dmaIrqRecord(dev,start,rxCount,txCount,refill);
+
       // Enable interrupts
-      if ( dev->debug > 0 ) 
-         dev_info(dev->device,"Irq: Done.\n");
+      if ( dmaDebug(dev) ) Dma_Trace(dev,DMA_TRACE_IRQ,0,0,0,0,0);
       iowrite32(1,&(reg->irq));
       ret = IRQ_HANDLED;
    }
@@ -317,7 +318,7 @@ int32_t TemG3_SendBuffer(struct DmaDevice *dev, struct DmaBuffer **buff, uint32_
       descB = buff[x]->buffHandle;
 
       // Lock hw
-      spin_lock(&dev->writeHwLock);
+      dmaSpinLock(&dev->writeHwLock,&dev->writeHwStats);
 
       // Write descriptor
       iowrite32(descA,&(reg->txWrA[dmaId]));
@@ -357,7 +358,7 @@ int32_t TemG3_Command(struct DmaDevice *dev, uint32_t cmd, uint64_t arg) {
 
          if ( tempLane > 8 ) return(0);
 
-         spin_lock(&dev->commandLock);
+         dmaSpinLock(&dev->commandLock,&dev->commandStats);
 
          // Set loop
          if ( tempVal ) {
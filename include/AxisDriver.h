@@ -24,7 +24,66 @@
 #include "DmaDriver.h"
 
 // Commands
-#define AXIS_Read_Ack 0x2001
+#define AXIS_Read_Ack       0x2001
+#define AXIS_Set_Moderation 0x2002
+#define AXIS_Get_Moderation 0x2003
+#define AXIS_Post_Bench     0x2004
+#define AXIS_Set_TxClass    0x2005
+#define AXIS_Set_TxDest     0x2006
+#define AXIS_Set_Pace       0x2007
+
+// Transmit classes, 128-bit descriptor mode
+// Sends which can not be posted directly are queued per class. Strict classes
+// drain first in class order, the others share the ring by weight in frames.
+// All dests start in class 0, all classes start weighted with weight 1.
+#define AXIS_TX_CLASSES 4
+
+// Interrupt moderation
+// Interrupt service is held off for up to holdoff uS after an interrupt
+// unless minFrames receive entries are already waiting, minFrames = 0 always holds off.
+// When adaptive is non zero the holdoff is only applied while the observed
+// ring entry rate is above adaptive entries per second. holdoff = 0 disables moderation.
+// minFrames and adaptive only take effect when holdoff is set, setting either with
+// holdoff = 0, holdoff above AXIS_MOD_MAX_HOLDOFF or minFrames larger than the
+// receive ring is rejected. rate and deferred are returned by AXIS_Get_Moderation
+#define AXIS_MOD_MAX_HOLDOFF 10000
+
+struct AxisModeration {
+   uint32_t minFrames;
+   uint32_t holdoff;
+   uint32_t adaptive;
+   uint32_t rate;
+   uint32_t deferred;
+   uint32_t pad;
+};
+
+// Descriptor posting benchmark
+// Times count descriptor sized bursts of four 32-bit or two 64-bit writes
+// to spare registers, and count address table writes through the uncached
+// and write combined mappings. Results are total nS, 0 when not supported.
+// Refused with EBUSY unless the caller is the only open descriptor, no dest
+// is enabled and no transmit frame is in flight.
+struct AxisPostBench {
+   uint32_t count;
+   uint32_t pad;
+   uint64_t narrowNs;
+   uint64_t wideNs;
+   uint64_t tableNs;
+   uint64_t tableWcNs;
+};
+
+// Transmit pacing per dest
+// Frames to a paced dest are released no faster than frameRate frames per second
+// and byteRate bytes per second, a zero rate is not limited. frameBurst frames
+// and byteBurst bytes may go back to back after the dest has been idle.
+// Both rates zero disables pacing for the dest.
+struct AxisPace {
+   uint32_t dest;
+   uint32_t frameRate;
+   uint32_t frameBurst;
+   uint32_t byteBurst;
+   uint64_t byteRate;
+};
 
 // Everything below is hidden during kernel module compile
 #ifndef DMA_IN_KERNEL
@@ -60,6 +119,52 @@ static inline void axisReadAck (int32_t fd) {
    ioctl(fd,AXIS_Read_Ack,0);
 }
 
+// Set interrupt moderation
+static inline ssize_t axisSetModeration (int32_t fd, uint32_t minFrames, uint32_t holdoff, uint32_t adaptive) {
+   struct AxisModeration mod;
+
+   memset(&mod,0,sizeof(struct AxisModeration));
+   mod.minFrames = minFrames;
+   mod.holdoff   = holdoff;
+   mod.adaptive  = adaptive;
+   return(ioctl(fd,AXIS_Set_Moderation,&mod));
+}
+
+// Get interrupt moderation and observed rate
+static inline ssize_t axisGetModeration (int32_t fd, struct AxisModeration *mod) {
+   return(ioctl(fd,AXIS_Get_Moderation,mod));
+}
+
+// Set transmit class strict priority or weight
+static inline ssize_t axisSetTxClass (int32_t fd, uint32_t cls, uint32_t strict, uint32_t weight) {
+   return(ioctl(fd,AXIS_Set_TxClass,((cls & 0xFF) << 24) | ((strict & 0x1) << 16) | (weight & 0xFFFF)));
+}
+
+// Assign dest to transmit class
+static inline ssize_t axisSetTxDest (int32_t fd, uint32_t dest, uint32_t cls) {
+   return(ioctl(fd,AXIS_Set_TxDest,((cls & 0xFF) << 16) | (dest & 0xFFFF)));
+}
+
+// Set transmit pacing for dest
+static inline ssize_t axisSetPace (int32_t fd, uint32_t dest, uint32_t frameRate, uint32_t frameBurst, uint64_t byteRate, uint32_t byteBurst) {
+   struct AxisPace pace;
+
+   memset(&pace,0,sizeof(struct AxisPace));
+   pace.dest       = dest;
+   pace.frameRate  = frameRate;
+   pace.frameBurst = frameBurst;
+   pace.byteRate   = byteRate;
+   pace.byteBurst  = byteBurst;
+   return(ioctl(fd,AXIS_Set_Pace,&pace));
+}
+
+// Run descriptor posting benchmark
+static inline ssize_t axisPostBench (int32_t fd, uint32_t count, struct AxisPostBench *bench) {
+   memset(bench,0,sizeof(struct AxisPostBench));
+   bench->count = count;
+   return(ioctl(fd,AXIS_Post_Bench,bench));
+}
+
 #endif
 #endif
 
@@ -49,10 +49,32 @@
 #define DMA_Read_Register    0x100B
 #define DMA_Get_RxBuff_Count 0x100C
 #define DMA_Get_TxBuff_Count 0x100D
+#define DMA_Reg_Vector       0x100E
+#define DMA_Set_Overflow     0x100F
+#define DMA_Get_Drops        0x1010
+#define DMA_Set_Secondary    0x1011
+#define DMA_Set_Filter       0x1012
+#define DMA_Get_Filter       0x1013
+#define DMA_Add_Dest         0x1014
+#define DMA_Rem_Dest         0x1015
+#define DMA_Take_Dest        0x1016
+#define DMA_Reset_IrqStats   0x1017
+#define DMA_Get_DestStats    0x1018
+#define DMA_Get_Latency      0x1019
+#define DMA_Set_LockStats    0x101A
+#define DMA_Get_Series       0x101B
 
 // Mask size
 #define DMA_MASK_SIZE 512
 
+// Receive queue overflow modes
+// BLOCK keeps frames until read, hardware is backpressured once the free list is empty
+// DROP_NEW returns the arriving frame to the free list when the queue is at its depth
+// DROP_OLD returns the oldest queued frame to the free list when the queue is at its depth
+#define DMA_OVF_BLOCK    0x0
+#define DMA_OVF_DROP_NEW 0x1
+#define DMA_OVF_DROP_OLD 0x2
+
 // TX Structure
 // Size = 0 for return index
 struct DmaWriteData {
@@ -84,6 +106,149 @@ struct DmaRegisterData {
    uint32_t   data;
 };
 
+// Receive queue overflow configuration
+// Depth = 0 allows all receive buffers to be queued
+struct DmaOverflowData {
+   uint32_t   mode;
+   uint32_t   depth;
+};
+
+// Drop counters
+// Dest is passed in, returns overflow drops for dest, drops seen by the calling descriptor
+// and frames recycled for dest while nobody was reading it
+struct DmaDropData {
+   uint32_t   dest;
+   uint32_t   destDrops;
+   uint32_t   descDrops;
+   uint32_t   idleDrops;
+};
+
+// Secondary (read only) receive attachment
+// Buffers are shared with the destination owner and other secondaries and
+// are returned to hardware once all holders have released them.
+// maxHeld limits the buffers held by the secondary, queued or by index,
+// arriving frames are skipped for the secondary once the limit is reached.
+// maxHeld = 0 selects a default of 1/16 of the receive buffers.
+// A stalled secondary keeps at most maxHeld buffers until it reads, returns or closes,
+// held buffers are never reclaimed by age as the reader may still access them.
+// A tap samples the stream, prescale passes one in N frames and rateLimit
+// passes at most N frames per second. Zero disables either.
+struct DmaSecondaryData {
+   uint32_t   maxHeld;
+   uint32_t   prescale;
+   uint32_t   rateLimit;
+   uint32_t   pad;
+   uint8_t    mask[DMA_MASK_SIZE];
+};
+
+// Receive filter
+// Rules are checked in order, the first DELIVER or DROP rule which matches
+// decides the frame, COUNT rules only increment hits. Unmatched frames are delivered.
+// A rule matches when dest and size are within the inclusive ranges and
+// (flags & flagsMask) == flagsValue and (error & errorMask) == errorValue
+#define DMA_MAX_FILTER   16
+#define DMA_FILT_DELIVER 0x0
+#define DMA_FILT_DROP    0x1
+#define DMA_FILT_COUNT   0x2
+
+// Receive filter rule, hits is returned by DMA_Get_Filter
+struct DmaFilterRule {
+   uint32_t   destMin;
+   uint32_t   destMax;
+   uint32_t   sizeMin;
+   uint32_t   sizeMax;
+   uint32_t   flagsMask;
+   uint32_t   flagsValue;
+   uint32_t   errorMask;
+   uint32_t   errorValue;
+   uint32_t   action;
+   uint32_t   hits;
+};
+
+// Per destination traffic counters
+// The array of DMA_STATS_COUNT entries, indexed by dest, can be mapped read only
+// at mmap offset DMA_STATS_OFFSET when the buffer space ends below that offset.
+// Counters are updated in the receive and transmit completion paths without locking,
+// 64-bit values may be seen torn on 32-bit hosts while they change.
+// errBits[N] counts received frames with error bit N set, sizeHist[N] counts received
+// frames with size in [2^(N-1),2^N), the last bin counts all larger frames.
+#define DMA_STATS_COUNT    4096
+#define DMA_STATS_OFFSET   0x7FF00000
+#define DMA_STATS_ERR_BITS 8
+#define DMA_STATS_BINS     24
+struct DmaDestStats {
+   uint32_t   dest;
+   uint32_t   rxErrors;
+   uint64_t   rxFrames;
+   uint64_t   rxBytes;
+   uint64_t   txFrames;
+   uint64_t   txBytes;
+   uint64_t   dropBytes;
+   uint32_t   ovfDrops;
+   uint32_t   idleDrops;
+   uint32_t   errBits[DMA_STATS_ERR_BITS];
+   uint32_t   sizeHist[DMA_STATS_BINS];
+   uint32_t   pad[18];
+};
+
+// Receive latency histograms for the calling descriptor, times in uS
+// queue is frame completion to dequeue by read, hold is dequeue to index return
+// by the primary reader. Bin N counts times in [2^(N-1),2^N).
+// held and oldest describe the indexes the descriptor holds now.
+#define DMA_LAT_BINS 32
+struct DmaLatencyData {
+   uint32_t   queueHist[DMA_LAT_BINS];
+   uint32_t   holdHist[DMA_LAT_BINS];
+   uint32_t   queueMax;
+   uint32_t   holdMax;
+   uint32_t   held;
+   uint32_t   oldest;
+};
+
+// Device throughput time series, one sample per interval summed over all dests
+// Counts are for the interval ending at time (nS, monotonic) which lasted period uS.
+// freeDepth is the number of receive buffers held by hardware at the end of the interval.
+// DMA_Get_Series returns the newest count samples oldest first, seq is the
+// number of samples taken since load.
+#define DMA_SERIES_SIZE 512
+struct DmaSample {
+   uint64_t   time;
+   uint64_t   rxFrames;
+   uint64_t   rxBytes;
+   uint64_t   txFrames;
+   uint64_t   txBytes;
+   uint32_t   rxErrors;
+   uint32_t   drops;
+   uint32_t   freeDepth;
+   uint32_t   period;
+};
+
+struct DmaSeries {
+   uint32_t   interval;
+   uint32_t   count;
+   uint64_t   seq;
+   struct DmaSample sample[DMA_SERIES_SIZE];
+};
+
+// Register transaction types
+#define DMA_REG_READ  0x0
+#define DMA_REG_WRITE 0x1
+#define DMA_REG_RMW   0x2
+#define DMA_REG_POLL  0x3
+
+// Register transaction, for vectored access
+// RMW writes (reg & ~mask) | (data & mask)
+// POLL reads until (reg & mask) == data or timeout (uS) expires
+// Register value after read, rmw and poll is returned in rdData
+struct DmaRegisterOp {
+   uint32_t   address;
+   uint32_t   op;
+   uint32_t   data;
+   uint32_t   mask;
+   uint32_t   timeout;
+   uint32_t   rdData;
+};
+
 // Everything below is hidden during kernel module compile
 #ifndef DMA_IN_KERNEL
 #include <stdlib.h>
@@ -336,11 +501,31 @@ static inline ssize_t dmaUnMapDma(int32_t fd, void ** buffer) {
    return(0);
 }
 
+// Map read only per destination counters, returns NULL on failure
+static inline const struct DmaDestStats * dmaMapDestStats(int32_t fd) {
+   void * temp;
+
+   temp = mmap (0, DMA_STATS_COUNT * sizeof(struct DmaDestStats), PROT_READ, MAP_SHARED, fd, DMA_STATS_OFFSET);
+   if ( temp == MAP_FAILED ) return(NULL);
+   return((const struct DmaDestStats *)temp);
+}
+
+// Free mapping to per destination counters
+static inline ssize_t dmaUnMapDestStats(const struct DmaDestStats * stats) {
+   return(munmap((void *)stats, DMA_STATS_COUNT * sizeof(struct DmaDestStats)));
+}
+
 // Set debug
 static inline ssize_t dmaSetDebug(int32_t fd, uint32_t level) {
    return(ioctl(fd,DMA_Set_Debug,level));
 }
 
+// Set debug level with trace sampling
+// Per frame debug is recorded in the debugfs trace file, one in sample events is kept
+static inline ssize_t dmaSetDebugSample(int32_t fd, uint32_t level, uint32_t sample) {
+   return(ioctl(fd,DMA_Set_Debug,((sample & 0xFFFF) << 16) | (level & 0xFF)));
+}
+
 // Assign interrupt handler
 static inline void dmaAssignHandler (int32_t fd, void (*handler)(int32_t)) {
    struct sigaction act;
@@ -383,6 +568,132 @@ static inline ssize_t dmaSetMaskBytes(int32_t fd, uint8_t * mask) {
    return(ioctl(fd,DMA_Set_MaskBytes,mask));
 }
 
+// Add destination to descriptor, fails if owned by another descriptor
+static inline ssize_t dmaAddDest(int32_t fd, uint32_t dest) {
+   return(ioctl(fd,DMA_Add_Dest,dest));
+}
+
+// Remove destination from descriptor, already queued frames are kept
+static inline ssize_t dmaRemDest(int32_t fd, uint32_t dest) {
+   return(ioctl(fd,DMA_Rem_Dest,dest));
+}
+
+// Take destination from current owner along with its queued frames
+// Returns number of frames moved
+static inline ssize_t dmaTakeDest(int32_t fd, uint32_t dest) {
+   return(ioctl(fd,DMA_Take_Dest,dest));
+}
+
+// Enable or disable lock contention statistics, shown in /proc
+static inline ssize_t dmaSetLockStats(int32_t fd, uint32_t enable) {
+   return(ioctl(fd,DMA_Set_LockStats,enable));
+}
+
+// Reset interrupt handler histograms
+static inline ssize_t dmaResetIrqStats(int32_t fd) {
+   return(ioctl(fd,DMA_Reset_IrqStats,0));
+}
+
+// Get traffic counters for destination
+static inline ssize_t dmaGetDestStats(int32_t fd, uint32_t dest, struct DmaDestStats *stats) {
+   memset(stats,0,sizeof(struct DmaDestStats));
+   stats->dest = dest;
+   return(ioctl(fd,DMA_Get_DestStats,stats));
+}
+
+// Get receive queue and index hold latency for this descriptor
+static inline ssize_t dmaGetLatency(int32_t fd, struct DmaLatencyData *lat) {
+   memset(lat,0,sizeof(struct DmaLatencyData));
+   return(ioctl(fd,DMA_Get_Latency,lat));
+}
+
+// Get device throughput time series, returns number of samples
+static inline ssize_t dmaGetSeries(int32_t fd, struct DmaSeries *series) {
+   return(ioctl(fd,DMA_Get_Series,series));
+}
+
+// Set receive queue overflow mode and depth
+static inline ssize_t dmaSetOverflow(int32_t fd, uint32_t mode, uint32_t depth) {
+   struct DmaOverflowData ovf;
+
+   ovf.mode  = mode;
+   ovf.depth = depth;
+   return(ioctl(fd,DMA_Set_Overflow,&ovf));
+}
+
+// Get drop counters for destination and for this descriptor
+static inline ssize_t dmaGetDrops(int32_t fd, uint32_t dest, uint32_t *destDrops, uint32_t *descDrops) {
+   struct DmaDropData drop;
+   ssize_t res;
+
+   memset(&drop,0,sizeof(struct DmaDropData));
+   drop.dest = dest;
+   res = ioctl(fd,DMA_Get_Drops,&drop);
+
+   if ( destDrops != NULL ) *destDrops = drop.destDrops;
+   if ( descDrops != NULL ) *descDrops = drop.descDrops;
+
+   return(res);
+}
+
+// Get count of frames recycled for destination while nobody was reading it
+static inline ssize_t dmaGetIdleDrops(int32_t fd, uint32_t dest, uint32_t *idleDrops) {
+   struct DmaDropData drop;
+   ssize_t res;
+
+   memset(&drop,0,sizeof(struct DmaDropData));
+   drop.dest = dest;
+   res = ioctl(fd,DMA_Get_Drops,&drop);
+
+   if ( idleDrops != NULL ) *idleDrops = drop.idleDrops;
+
+   return(res);
+}
+
+// Attach as secondary reader for destinations in mask byte array
+static inline ssize_t dmaSetSecondary(int32_t fd, uint8_t * mask, uint32_t maxHeld) {
+   struct DmaSecondaryData sec;
+
+   memset(&sec,0,sizeof(struct DmaSecondaryData));
+   sec.maxHeld = maxHeld;
+   memcpy(sec.mask,mask,DMA_MASK_SIZE);
+   return(ioctl(fd,DMA_Set_Secondary,&sec));
+}
+
+// Attach as sampling tap for destinations in mask byte array
+// Passes one in prescale frames, limited to rateLimit frames per second
+static inline ssize_t dmaSetTap(int32_t fd, uint8_t * mask, uint32_t prescale, uint32_t rateLimit) {
+   struct DmaSecondaryData sec;
+
+   memset(&sec,0,sizeof(struct DmaSecondaryData));
+   sec.prescale  = prescale;
+   sec.rateLimit = rateLimit;
+   memcpy(sec.mask,mask,DMA_MASK_SIZE);
+   return(ioctl(fd,DMA_Set_Secondary,&sec));
+}
+
+// Init filter rule to match all frames
+static inline void dmaInitFilterRule(struct DmaFilterRule * rule, uint32_t action) {
+   memset(rule,0,sizeof(struct DmaFilterRule));
+   rule->destMax = 0xFFFFFFFF;
+   rule->sizeMax = 0xFFFFFFFF;
+   rule->action  = action;
+}
+
+// Set receive filter rules, count = 0 clears the filter
+static inline ssize_t dmaSetFilter(int32_t fd, uint32_t count, struct DmaFilterRule *rules) {
+   uint32_t cmd = DMA_Set_Filter | ((count << 16) & 0xFFFF0000);
+
+   return(ioctl(fd,cmd,rules));
+}
+
+// Get receive filter rules with hit counters, returns number of rules
+static inline ssize_t dmaGetFilter(int32_t fd, uint32_t count, struct DmaFilterRule *rules) {
+   uint32_t cmd = DMA_Get_Filter | ((count << 16) & 0xFFFF0000);
+
+   return(ioctl(fd,cmd,rules));
+}
+
 // Check API version, return negative on error
 static inline ssize_t dmaCheckVersion(int32_t fd) {
    int32_t version;
@@ -413,6 +724,15 @@ static inline ssize_t dmaReadRegister(int32_t fd, uint32_t address, uint32_t *da
    return(res);
 }
 
+// Execute a list of register transactions in a single call
+// Returns number of transactions completed, a short count indicates
+// that the transaction at the returned position failed or timed out
+static inline ssize_t dmaRegisterVector(int32_t fd, struct DmaRegisterOp *ops, uint32_t count) {
+   uint32_t cmd = DMA_Reg_Vector | ((count << 16) & 0xFFFF0000);
+
+   return(ioctl(fd,cmd,ops));
+}
+
 #endif
 #endif
 
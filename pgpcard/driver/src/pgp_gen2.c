@@ -48,8 +48,11 @@ irqreturn_t PgpCardG2_Irq(int irq, void *dev_id) {
    uint32_t    dmaId;
    uint32_t    subId;
    irqreturn_t ret;
+   uint32_t    rxCount;
+   uint32_t    txCount;
+   uint32_t    refill;
+   uint64_t    start;
 
-   struct DmaDesc      * desc;
    struct DmaBuffer    * buff;
    struct DmaDevice    * dev;
    struct PgpInfo      * info;
@@ -66,7 +69,10 @@ irqreturn_t PgpCardG2_Irq(int irq, void *dev_id) {
    // Is this the source
    if ( (stat & 0x2) != 0 ) {
 
-      if ( dev->debug > 0 ) dev_info(dev->device,"Irq: IRQ Called.\n");
+      start   = ktime_get_ns();
+      rxCount = 0;
+      txCount = 0;
+      refill  = 0;
 
       // Disable interrupts
       iowrite32(0,&(reg->irq));
@@ -83,12 +89,14 @@ irqreturn_t PgpCardG2_Irq(int irq, void *dev_id) {
             // Read dma value
             stat = ioread32(&(reg->txRead));
             asm("nop");
-            if ( dev->debug > 0 ) 
-               dev_info(dev->device,"Irq: Return TX Status Value %.8x.\n",stat);
+            if ( dmaDebug(dev) ) Dma_Trace(dev,DMA_TRACE_TX,stat,0,0,0,0);
+
+            txCount++;
 
             // Attempt to find buffer in tx pool and return. otherwise return rx entry to hw.
             if ((buff = dmaRetBufferIrq (dev,stat&0xFFFFFFFC)) != NULL) {
                iowrite32((stat & 0xFFFFFFFC),&(reg->rxFree));
+               refill++;
             }
 
          // Repeat while next valid flag is set
@@ -114,6 +122,7 @@ irqreturn_t PgpCardG2_Irq(int irq, void *dev_id) {
 
                // Extract data from descriptor
                buff->count++;
+               rxCount++;
                dmaId       = (descA >> 30) & 0x3;
                subId       = (descA >> 28) & 0x3;
                buff->flags = (descA >> 27) & 0x1;
@@ -138,30 +147,21 @@ irqreturn_t PgpCardG2_Irq(int irq, void *dev_id) {
                if ( (descA >> 25) & 0x1) buff->error |= DMA_ERR_FIFO;
                if ( (descA >> 24) & 0x1) buff->error |= PGP_ERR_EOFE;
 
-               if ( dev->debug > 0 ) {
-                  dev_info(dev->device,"Irq: Rx Size=%i, Dest=0x%x, Error=0x%x, Cont=%i.\n",
-                     buff->size, buff->dest, buff->error, buff->flags);
-               }
+               if ( dmaDebug(dev) ) Dma_Trace(dev,DMA_TRACE_RX,buff->index,buff->dest,buff->size,buff->flags,buff->error);
 
                // Lock mask records
                // This ensures close does not occur while irq routine is 
                // pushing data to desc rx queue
-               spin_lock(&dev->maskLock);
-
-               // Find owner of destination
-               desc = dev->desc[buff->dest];
-
-               // Return entry to FPGA if /vc is not open
-               if ( desc == NULL ) {
-                  if ( dev->debug > 0 ) {
-                     dev_info(dev->device,"Irq: Port not open return to free list.\n");
-                  }
-                  iowrite32((descB & 0xFFFFFFFC),&(reg->rxFree));
+               dmaSpinLock(&dev->maskLock,&dev->maskStats);
+
+               // Deliver to owner of destination and secondary readers
+               // Return entry to FPGA if lane/vc is not open or frame was dropped
+               if ( (buff = dmaRxDeliverIrq(dev,buff)) != NULL ) {
+                  if ( dmaDebug(dev) ) Dma_Trace(dev,DMA_TRACE_RX_RET,buff->index,buff->dest,buff->size,0,0);
+                  iowrite32(buff->buffHandle,&(reg->rxFree));
+                  refill++;
                }
 
-               // lane/vc is open,  Add to RX Queue
-               else dmaRxBuffer(desc,buff);
-
                // Unlock
                spin_unlock(&dev->maskLock);
             }
@@ -174,9 +174,10 @@ irqreturn_t PgpCardG2_Irq(int irq, void *dev_id) {
          } while ( (descB & 0x2) != 0 );
       }
 
+      dmaIrqRecord(dev,start,rxCount,txCount,refill);
+
       // Enable interrupts
-      if ( dev->debug > 0 ) 
-         dev_info(dev->device,"Irq: Done.\n");
+      if ( dmaDebug(dev) ) Dma_Trace(dev,DMA_TRACE_IRQ,0,0,0,0,0);
       iowrite32(1,&(reg->irq));
       ret = IRQ_HANDLED;
    }
@@ -363,7 +364,7 @@ int32_t PgpCardG2_SendBuffer(struct DmaDevice *dev, struct DmaBuffer **buff, uin
       descB = buff[x]->buffHandle;
 
       // Lock hw
-      spin_lock(&dev->writeHwLock);
+      dmaSpinLock(&dev->writeHwLock,&dev->writeHwStats);
 
       // Write descriptor
       switch ( dmaId ) {
@@ -426,7 +427,7 @@ int32_t PgpCardG2_Command(struct DmaDevice *dev, uint32_t cmd, uint64_t arg) {
 
          if ( tempLane > 4 ) return(0);
 
-         spin_lock(&dev->commandLock);
+         dmaSpinLock(&dev->commandLock,&dev->commandStats);
 
          // Set loop
          if ( tempVal ) {
@@ -449,7 +450,7 @@ int32_t PgpCardG2_Command(struct DmaDevice *dev, uint32_t cmd, uint64_t arg) {
 
       // Reset counters
       case PGP_Count_Reset:
-         spin_lock(&dev->commandLock);
+         dmaSpinLock(&dev->commandLock,&dev->commandStats);
          tmp = ioread32(&(reg->control)); // Store old reg val
          iowrite32(tmp|0x1,&(reg->control)); // Set reset bit
          iowrite32(tmp,&(reg->control)); // Set old reg val
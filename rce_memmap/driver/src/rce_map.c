@@ -19,6 +19,7 @@
  * ----------------------------------------------------------------------------
 **/
 #include <rce_map.h>
+#include <dma_reg.h>
 #include <linux/module.h>
 #include <linux/moduleparam.h>
 #include <linux/types.h>
@@ -31,6 +32,8 @@
 #include <linux/of_address.h>
 #include <linux/of_irq.h>
 #include <linux/slab.h>
+#include <linux/delay.h>
+#include <linux/jiffies.h>
 
 // Module Name
 #define MOD_NAME "rce_memmap"
@@ -231,6 +234,45 @@ uint8_t * Map_Find(uint32_t addr) {
    return(NULL);
 }
 
+// Execute a list of register transactions
+// Returns number of transactions completed, stops at first failure
+ssize_t Map_RegisterVector(uint32_t cmd, unsigned long arg) {
+   struct DmaRegisterOp * ops;
+   uint8_t * base;
+   uint32_t  cnt;
+   uint32_t  x;
+   ssize_t   ret;
+
+   cnt = (cmd >> 16) & 0xFFFF;
+   if ( cnt == 0 ) return(0);
+
+   if ( (ops = (struct DmaRegisterOp *)kmalloc(cnt * sizeof(struct DmaRegisterOp),GFP_KERNEL)) == NULL ) {
+      printk(KERN_WARNING MOD_NAME " Dma_Reg_Vector: Failed to allocate %i transactions.\n",cnt);
+      return(-1);
+   }
+
+   if ((ret = copy_from_user(ops,(void *)arg,cnt * sizeof(struct DmaRegisterOp)))) {
+      printk(KERN_WARNING MOD_NAME " Dma_Reg_Vector: copy_from_user failed. ret=%i, user=%p kern=%p\n", ret, (void *)arg, ops);
+      kfree(ops);
+      return(-1);
+   }
+
+   for (x=0; x < cnt; x++) {
+      if ( (base = Map_Find(ops[x].address)) == NULL ) break;
+      if ( dmaRegisterOp(base,&(ops[x])) < 0 ) break;
+   }
+
+   // Return read data
+   if ((ret = copy_to_user((void *)arg,ops,cnt * sizeof(struct DmaRegisterOp)))) {
+      printk(KERN_WARNING MOD_NAME " Dma_Reg_Vector: copy_to_user failed. ret=%i, user=%p kern=%p\n", ret, (void *)arg, ops);
+      kfree(ops);
+      return(-1);
+   }
+
+   kfree(ops);
+   return(x);
+}
+
 // Perform commands
 ssize_t Map_Ioctl(struct file *filp, uint32_t cmd, unsigned long arg) {
    struct DmaRegisterData rData;
@@ -238,7 +280,7 @@ ssize_t Map_Ioctl(struct file *filp, uint32_t cmd, unsigned long arg) {
    ssize_t ret;
 
    // Determine command
-   switch (cmd) {
+   switch (cmd & 0xFFFF) {
 
       // Get API Version
       case DMA_Get_Version:
@@ -278,6 +320,11 @@ ssize_t Map_Ioctl(struct file *filp, uint32_t cmd, unsigned long arg) {
          return(0);
          break;
 
+      // Register transaction list
+      case DMA_Reg_Vector:
+         return(Map_RegisterVector(cmd,arg));
+         break;
+
       default:
          break;
    }
@@ -69,6 +69,8 @@ ssize_t Map_Write(struct file *filp, const char* buffer, size_t count, loff_t* f
 
 uint8_t * Map_Find(uint32_t addr);
 
+ssize_t Map_RegisterVector(uint32_t cmd, unsigned long arg);
+
 ssize_t Map_Ioctl(struct file *filp, uint32_t cmd, unsigned long arg);
 
 #endif
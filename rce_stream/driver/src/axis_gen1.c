@@ -42,8 +42,11 @@ irqreturn_t AxisG1_Irq(int irq, void *dev_id) {
    uint32_t    handle;
    uint32_t    size;
    uint32_t    status;
+   uint32_t    rxCount;
+   uint32_t    txCount;
+   uint32_t    refill;
+   uint64_t    start;
 
-   struct DmaDesc     * desc;
    struct DmaBuffer   * buff;
    struct DmaDevice   * dev;
    struct AxisG1Reg   * reg;
@@ -57,6 +60,11 @@ irqreturn_t AxisG1_Irq(int irq, void *dev_id) {
        // Ack interrupt
       iowrite32(0x1,&(reg->intPendAck));
 
+      start   = ktime_get_ns();
+      rxCount = 0;
+      txCount = 0;
+      refill  = 0;
+
       // Disable interrupts
       iowrite32(0x0,&(reg->intEnable));
 
@@ -70,12 +78,14 @@ irqreturn_t AxisG1_Irq(int irq, void *dev_id) {
             if (((handle = ioread32(&(reg->txFree))) & 0x80000000) != 0 ) {
                handle &= 0x7FFFFFFC;
               
-               if ( dev->debug > 0 ) 
-                  dev_info(dev->device,"Irq: Return TX Status Value 0x%.8x.\n",handle);
+               if ( dmaDebug(dev) ) Dma_Trace(dev,DMA_TRACE_TX,handle,0,0,0,0);
+
+               txCount++;
 
                // Attempt to find buffer in tx pool and return. otherwise return rx entry to hw.
                if ((buff = dmaRetBufferIrq (dev,handle)) != NULL) {
                   iowrite32(handle,&(reg->rxFree));
+                  refill++;
                }
             }
          }
@@ -115,6 +125,7 @@ irqreturn_t AxisG1_Irq(int irq, void *dev_id) {
 
                   // Extract data from descriptor
                   buff->count++;
+                  rxCount++;
                   buff->size  = size;
                   buff->flags = (status >>  8) & 0xFFFF; // 15:8 = luser, 7:0 = fuser
                   buff->dest  = (status      ) & 0xFF;
@@ -130,31 +141,21 @@ irqreturn_t AxisG1_Irq(int irq, void *dev_id) {
                      buff->error |= DMA_ERR_LEN;
                   }
                
-                  if ( dev->debug > 0 ) {
-                     dev_info(dev->device,"Irq: Rx size=%i, Dest=%i, Flags=0x%x, Error=0x%x.\n",
-                        buff->size, buff->dest, buff->flags, buff->error);
-                  }
+                  if ( dmaDebug(dev) ) Dma_Trace(dev,DMA_TRACE_RX,buff->index,buff->dest,buff->size,buff->flags,buff->error);
 
                   // Lock mask records
                   // This ensures close does not occur while irq routine is 
                   // pushing data to desc rx queue
-                  spin_lock(&dev->maskLock);
-
-                  // Find owner of lane/vc
-                  if ( buff->dest < DMA_MAX_DEST ) desc = dev->desc[buff->dest];
-                  else desc = NULL;
-
-                  // Return entry to FPGA if destc is not open
-                  if ( desc == NULL ) {
-                     if ( dev->debug > 0 ) {
-                        dev_info(dev->device,"Irq: Port not open return to free list.\n");
-                     }
-                     iowrite32(handle,&(reg->rxFree));
+                  dmaSpinLock(&dev->maskLock,&dev->maskStats);
+
+                  // Deliver to owner of lane/vc and secondary readers
+                  // Return entry to FPGA if dest is not open or frame was dropped
+                  if ( (buff = dmaRxDeliverIrq(dev,buff)) != NULL ) {
+                     if ( dmaDebug(dev) ) Dma_Trace(dev,DMA_TRACE_RX_RET,buff->index,buff->dest,buff->size,0,0);
+                     iowrite32(buff->buffHandle,&(reg->rxFree));
+                     refill++;
                   }
 
-                  // lane/vc is open,  Add to RX Queue
-                  else dmaRxBuffer(desc,buff);
-
                   // Unlock
                   spin_unlock(&dev->maskLock);
                }
@@ -165,6 +166,8 @@ irqreturn_t AxisG1_Irq(int irq, void *dev_id) {
          }
       }
 
+      dmaIrqRecord(dev,start,rxCount,txCount,refill);
+
       // Enable interrupts
       iowrite32(0x1,&(reg->intEnable));
       return(IRQ_HANDLED);
@@ -276,7 +279,7 @@ int32_t AxisG1_SendBuffer(struct DmaDevice *dev, struct DmaBuffer **buff, uint32
       }
 
       // Write to hardware
-      spin_lock(&dev->writeHwLock);
+      dmaSpinLock(&dev->writeHwLock,&dev->writeHwStats);
 
       iowrite32(buff[x]->buffHandle,&(reg->txPostA));
       iowrite32(buff[x]->size,&(reg->txPostB));
@@ -297,7 +300,7 @@ int32_t AxisG1_Command(struct DmaDevice *dev, uint32_t cmd, uint64_t arg) {
 
       // Read ACK
       case AXIS_Read_Ack:
-         spin_lock(&dev->commandLock);
+         dmaSpinLock(&dev->commandLock,&dev->commandStats);
          iowrite32(0x3,&(reg->onlineAck));
          iowrite32(0x1,&(reg->onlineAck));
          spin_unlock(&dev->commandLock);
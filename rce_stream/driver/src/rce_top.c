@@ -49,6 +49,7 @@ int cfgSize2    = 4096*4;
 int cfgMode0    = BUFF_COHERENT;
 int cfgMode1    = BUFF_COHERENT;
 int cfgMode2    = BUFF_ARM_ACP | AXIS2_RING_ACP;
+int cfgIrqBudget = 0;
 
 struct DmaDevice gDmaDevices[MAX_DMA_DEVICES];
 
@@ -174,6 +175,7 @@ int Rce_Probe(struct platform_device *pdev) {
 
    // Instance independent
    dev->cfgCont = 1;
+   dev->cfgIrqBudget = cfgIrqBudget;
 
    // Set hardware functions
    // Version 2
@@ -277,3 +279,6 @@ MODULE_PARM_DESC(cfgMode1, "RX buffer mode");
 module_param(cfgMode2,int,0);
 MODULE_PARM_DESC(cfgMode2, "RX buffer mode");
 
+module_param(cfgIrqBudget,int,0);
+MODULE_PARM_DESC(cfgIrqBudget, "Threaded IRQ ring budget for gen2 engines, 0 to process rings in hard IRQ");
+